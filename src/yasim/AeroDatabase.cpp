@@ -0,0 +1,543 @@
+#include <cstring>
+#include <thread>
+
+#include "Math.hpp"
+#include "Model.hpp"
+#include "Atmosphere.hpp"
+#include "ControlMap.hpp"
+#include "Airplane.hpp"
+
+#include "AeroDatabase.hpp"
+namespace yasim {
+
+static const float YASIM_PI = 3.14159265358979323846;
+static const float DEG2RAD = YASIM_PI / 180;
+static const char MAGIC[4] = { 'Y', 'A', 'D', 'B' };
+static const int VERSION = 1;
+
+// The most floats read() will allocate for all the tables together
+// (256MB), whatever a file claims.
+static const long long MAX_FLOATS = 64 << 20;
+
+// Adds the size in floats of a table with the given dimensions to
+// *total.  Returns false, at the first multiply that would, if that
+// goes over MAX_FLOATS; every factor is positive and at most 100000,
+// so nothing overflows on the way.
+static bool addTableSize(long long* total, int n0, int n1,
+                         int n2 = 1, int n3 = 1)
+{
+    int n[4] = { n0, n1, n2, n3 };
+    long long size = AeroDatabase::NCOEFS;
+    for(int i=0; i<4; i++) {
+        size *= n[i];
+        if(size > MAX_FLOATS)
+            return false;
+    }
+    *total += size;
+    return *total <= MAX_FLOATS;
+}
+
+AeroDatabase::AeroDatabase()
+{
+    setAxis(ALPHA, -YASIM_PI, YASIM_PI, 1441);
+    setAxis(BETA, -45 * DEG2RAD, 45 * DEG2RAD, 37);
+    setAxis(SPEED, 50, 50, 1);
+    setAxis(ALT, 0, 0, 1);
+    _rateDelta = 0.01f;
+    _base = 0;
+    _rates = 0;
+    _nevals = 0;
+    _results = 0;
+}
+
+AeroDatabase::~AeroDatabase()
+{
+    freeTables();
+    for(int i=0; i<_controls.size(); i++) {
+        ControlRec* c = (ControlRec*)_controls.get(i);
+        delete[] c->name;
+        delete c;
+    }
+}
+
+void AeroDatabase::freeTables()
+{
+    delete[] _base;
+    delete[] _rates;
+    _base = _rates = 0;
+    for(int i=0; i<_controls.size(); i++) {
+        ControlRec* c = (ControlRec*)_controls.get(i);
+        delete[] c->table;
+        c->table = 0;
+    }
+}
+
+void AeroDatabase::allocTables()
+{
+    freeTables();
+    int na = _axes[ALPHA].n;
+    _base = new float[baseSize() * NCOEFS];
+    _rates = new float[na * 3 * NCOEFS];
+    for(int i=0; i<_controls.size(); i++) {
+        ControlRec* c = (ControlRec*)_controls.get(i);
+        c->table = new float[na * c->axis.n * NCOEFS];
+    }
+}
+
+int AeroDatabase::baseSize()
+{
+    return _axes[ALPHA].n * _axes[BETA].n * _axes[SPEED].n * _axes[ALT].n;
+}
+
+void AeroDatabase::setAxis(int axis, float min, float max, int n)
+{
+    _axes[axis].min = min;
+    _axes[axis].max = max;
+    _axes[axis].n = n < 1 ? 1 : n;
+}
+
+void AeroDatabase::addControl(int input, const char* name, float min,
+                              float max, int n)
+{
+    ControlRec* c = new ControlRec();
+    c->input = input;
+    c->name = new char[strlen(name)+1];
+    strcpy(c->name, name);
+    c->axis.min = min;
+    c->axis.max = max;
+    c->axis.n = n < 2 ? 2 : n;
+    c->val = 0;
+    c->table = 0;
+    _controls.add(c);
+}
+
+void AeroDatabase::addClone(Airplane* airplane)
+{
+    _airplanes.add(airplane);
+}
+
+const char* AeroDatabase::getControlName(int control)
+{
+    return ((ControlRec*)_controls.get(control))->name;
+}
+
+float AeroDatabase::getControlMin(int control)
+{
+    return ((ControlRec*)_controls.get(control))->axis.min;
+}
+
+float AeroDatabase::getControlMax(int control)
+{
+    return ((ControlRec*)_controls.get(control))->axis.max;
+}
+
+void AeroDatabase::setControlInput(int control, int input)
+{
+    ((ControlRec*)_controls.get(control))->input = input;
+}
+
+void AeroDatabase::setInput(int input, float val)
+{
+    for(int i=0; i<_controls.size(); i++) {
+        ControlRec* c = (ControlRec*)_controls.get(i);
+        if(c->input == input)
+            c->val = val;
+    }
+}
+
+float AeroDatabase::gridPoint(Axis* a, int i)
+{
+    if(a->n == 1) return a->min;
+    return a->min + i * (a->max - a->min) / (a->n - 1);
+}
+
+// Finds the grid interval containing x, clamped to the ends of the
+// axis.  A single-point axis returns that point with a zero fraction.
+void AeroDatabase::locate(Axis* a, float x, int* i0, int* i1, float* frac)
+{
+    if(a->n == 1) {
+        *i0 = *i1 = 0;
+        *frac = 0;
+        return;
+    }
+    float u = (x - a->min) * (a->n - 1) / (a->max - a->min);
+    if(u < 0) u = 0;
+    if(u > a->n - 1) u = a->n - 1;
+    int i = (int)u;
+    if(i > a->n - 2) i = a->n - 2;
+    *i0 = i;
+    *i1 = i + 1;
+    *frac = u - i;
+}
+
+// Evaluations are numbered: the base grid; the reference (zero beta
+// and controls) at each alpha; each control's grid; then a +/- pair
+// for each rate axis at each alpha.
+void AeroDatabase::evaluate(Airplane* airplane, int eval)
+{
+    Model* model = airplane->getModel();
+    ControlMap* cm = airplane->getControlMap();
+    int na = _axes[ALPHA].n;
+    int i;
+
+    float x[NAXES], rate[3] = { 0, 0, 0 };
+    for(i=0; i<NAXES; i++)
+        x[i] = gridPoint(&_axes[i], 0);
+    x[BETA] = 0;
+    int ctl = -1;
+    float ctlVal = 0;
+
+    float* out;
+    int e = eval;
+    if(e < baseSize()) {
+        out = _base + e*NCOEFS;
+        int idx[NAXES];
+        for(i=NAXES-1; i>=0; i--) {
+            idx[i] = e % _axes[i].n;
+            e /= _axes[i].n;
+        }
+        for(i=0; i<NAXES; i++)
+            x[i] = gridPoint(&_axes[i], idx[i]);
+    } else if((e -= baseSize()) < na) {
+        // References go into the rate table's scratch space below
+        out = _results + e*NCOEFS;
+        x[ALPHA] = gridPoint(&_axes[ALPHA], e);
+    } else {
+        e -= na;
+        for(i=0; i<_controls.size(); i++) {
+            ControlRec* c = (ControlRec*)_controls.get(i);
+            if(e < na * c->axis.n) break;
+            e -= na * c->axis.n;
+        }
+        if(i < _controls.size()) {
+            ControlRec* c = (ControlRec*)_controls.get(i);
+            out = c->table + e*NCOEFS;
+            ctl = i;
+            x[ALPHA] = gridPoint(&_axes[ALPHA], e / c->axis.n);
+            ctlVal = gridPoint(&c->axis, e % c->axis.n);
+        } else {
+            out = _results + (na + e)*NCOEFS;
+            x[ALPHA] = gridPoint(&_axes[ALPHA], e / 6);
+            rate[(e % 6) / 2] = (e & 1) ? -_rateDelta : _rateDelta;
+        }
+    }
+
+    // Controls
+    cm->reset();
+    if(ctl >= 0) {
+        ControlRec* c = (ControlRec*)_controls.get(ctl);
+        if(c->input >= 0)
+            cm->setInput(c->input, ctlVal);
+    }
+    cm->applyControls(1000000); // Huge dt value
+
+    float rho = Atmosphere::getStdDensity(x[ALT]);
+    model->setAir(Atmosphere::getStdPressure(x[ALT]),
+                  Atmosphere::getStdTemperature(x[ALT]), rho);
+
+    // Level attitude, so local and global coordinates are the same.
+    // The airflow at the origin is va = -v + rot x cg.
+    float ca = Math::cos(x[ALPHA]), sa = Math::sin(x[ALPHA]);
+    float cb = Math::cos(x[BETA]), sb = Math::sin(x[BETA]);
+    float spd = x[SPEED];
+    float va[3], cg[3], tmp[3];
+    va[0] = -spd*ca*cb;
+    va[1] = spd*sb;
+    va[2] = spd*sa*cb;
+
+    State s;
+    for(i=0; i<9; i++)
+        s.orient[i] = (i%4 == 0) ? 1 : 0;
+    for(i=0; i<3; i++) {
+        s.pos[i] = s.acc[i] = s.racc[i] = 0;
+        s.rot[i] = rate[i] * spd;
+    }
+    s.pos[2] = 1;
+    model->getBody()->getCG(cg);
+    Math::cross3(s.rot, cg, tmp);
+    Math::sub3(tmp, va, s.v);
+
+    model->setState(&s);
+    model->initIteration(1.0/30);
+    model->getBody()->reset();
+
+    float force[3], torque[3], faero[3];
+    model->calcAeroForces(model->getState(), 0, faero);
+    model->getBody()->getForce(force);
+    model->getBody()->getTorque(torque);
+
+    // Moment about the origin instead of the c.g.
+    Math::cross3(cg, force, tmp);
+    Math::add3(torque, tmp, torque);
+
+    float iq = 1/(0.5f * rho * spd * spd);
+    for(i=0; i<3; i++) {
+        out[FX+i] = force[i] * iq;
+        out[MX+i] = torque[i] * iq;
+    }
+}
+
+void AeroDatabase::runWorker(Worker* w)
+{
+    for(int e=w->idx; e<w->db->_nevals; e+=w->stride)
+        w->db->evaluate(w->airplane, e);
+}
+
+void AeroDatabase::generate(Airplane* airplane)
+{
+    int i, j, k;
+    int na = _axes[ALPHA].n;
+    int nworkers = _airplanes.size() + 1;
+    Airplane** airplanes = new Airplane*[nworkers];
+    airplanes[0] = airplane;
+    for(i=1; i<nworkers; i++)
+        airplanes[i] = (Airplane*)_airplanes.get(i-1);
+
+    allocTables();
+    _nevals = baseSize() + na + na*6;
+    for(i=0; i<_controls.size(); i++)
+        _nevals += na * ((ControlRec*)_controls.get(i))->axis.n;
+    _results = new float[(na + na*6) * NCOEFS];
+
+    // Still air, as in the Linearizer.
+    Turbulence** turb = new Turbulence*[nworkers];
+    for(i=0; i<nworkers; i++) {
+        Model* m = airplanes[i]->getModel();
+        turb[i] = m->getTurbulence();
+        m->setTurbulence(0);
+        m->getBody()->recalc();
+    }
+
+    Worker* workers = new Worker[nworkers];
+    std::thread* threads = new std::thread[nworkers];
+    for(i=0; i<nworkers; i++) {
+        workers[i].db = this;
+        workers[i].airplane = airplanes[i];
+        workers[i].idx = i;
+        workers[i].stride = nworkers;
+        if(i > 0)
+            threads[i] = std::thread(runWorker, &workers[i]);
+    }
+    runWorker(&workers[0]);
+    for(i=1; i<nworkers; i++)
+        threads[i].join();
+    delete[] threads;
+    delete[] workers;
+
+    // Control tables become increments over the reference, and the
+    // rate pairs become derivatives.
+    float* ref = _results;
+    for(i=0; i<_controls.size(); i++) {
+        ControlRec* c = (ControlRec*)_controls.get(i);
+        for(j=0; j<na; j++)
+            for(k=0; k<c->axis.n*NCOEFS; k++)
+                c->table[(j*c->axis.n)*NCOEFS + k] -= ref[j*NCOEFS + k%NCOEFS];
+    }
+    float* pairs = _results + na*NCOEFS;
+    for(j=0; j<na*3; j++)
+        for(k=0; k<NCOEFS; k++)
+            _rates[j*NCOEFS + k] = (pairs[(2*j)*NCOEFS + k]
+                                    - pairs[(2*j+1)*NCOEFS + k]) / (2*_rateDelta);
+
+    for(i=0; i<nworkers; i++)
+        airplanes[i]->getModel()->setTurbulence(turb[i]);
+    delete[] turb;
+    delete[] airplanes;
+    delete[] _results;
+    _results = 0;
+}
+
+void AeroDatabase::getCoefs(float* va, float* rot, float rho, float* coefs)
+{
+    int i, j, k;
+    for(k=0; k<NCOEFS; k++)
+        coefs[k] = 0;
+
+    float spd = Math::mag3(va);
+    if(spd == 0)
+        return;
+
+    float x[NAXES];
+    x[ALPHA] = Math::atan2(va[2], -va[0]);
+    float sb = va[1] / spd;
+    x[BETA] = Math::asin(sb > 1 ? 1 : (sb < -1 ? -1 : sb));
+    x[SPEED] = spd;
+    x[ALT] = _axes[ALT].n > 1 ? densityAltitude(rho) : 0;
+
+    // Base table, multilinear over 16 corners
+    int i0[NAXES], i1[NAXES];
+    float frac[NAXES];
+    for(i=0; i<NAXES; i++)
+        locate(&_axes[i], x[i], &i0[i], &i1[i], &frac[i]);
+    for(i=0; i<16; i++) {
+        int idx = 0;
+        float w = 1;
+        for(j=0; j<NAXES; j++) {
+            bool hi = i & (1<<j);
+            idx = idx * _axes[j].n + (hi ? i1[j] : i0[j]);
+            w *= hi ? frac[j] : 1 - frac[j];
+        }
+        float* c = _base + idx*NCOEFS;
+        for(k=0; k<NCOEFS; k++)
+            coefs[k] += w * c[k];
+    }
+
+    // Control increments, bilinear in alpha and position
+    int a0 = i0[ALPHA], a1 = i1[ALPHA];
+    float fa = frac[ALPHA];
+    for(i=0; i<_controls.size(); i++) {
+        ControlRec* c = (ControlRec*)_controls.get(i);
+        int c0, c1;
+        float fc;
+        locate(&c->axis, c->val, &c0, &c1, &fc);
+        int n = c->axis.n;
+        float* t00 = c->table + (a0*n + c0)*NCOEFS;
+        float* t01 = c->table + (a0*n + c1)*NCOEFS;
+        float* t10 = c->table + (a1*n + c0)*NCOEFS;
+        float* t11 = c->table + (a1*n + c1)*NCOEFS;
+        for(k=0; k<NCOEFS; k++)
+            coefs[k] += (1-fa)*((1-fc)*t00[k] + fc*t01[k])
+                + fa*((1-fc)*t10[k] + fc*t11[k]);
+    }
+
+    // Rate derivatives, linear in alpha
+    float ispd = 1/spd;
+    for(j=0; j<3; j++) {
+        float* r0 = _rates + (a0*3 + j)*NCOEFS;
+        float* r1 = _rates + (a1*3 + j)*NCOEFS;
+        float r = rot[j] * ispd;
+        for(k=0; k<NCOEFS; k++)
+            coefs[k] += r * ((1-fa)*r0[k] + fa*r1[k]);
+    }
+}
+
+void AeroDatabase::calcForces(float* va, float* rot, float rho, float* force,
+                              float* moment)
+{
+    float coefs[NCOEFS];
+    getCoefs(va, rot, rho, coefs);
+    float q = 0.5f * rho * Math::dot3(va, va);
+    for(int i=0; i<3; i++) {
+        force[i] = q * coefs[FX+i];
+        moment[i] = q * coefs[MX+i];
+    }
+}
+
+// The standard atmosphere altitude with density rho, by bisection.
+float AeroDatabase::densityAltitude(float rho)
+{
+    float lo = -1000, hi = 30000;
+    for(int i=0; i<24; i++) {
+        float mid = 0.5f*(lo + hi);
+        if(Atmosphere::getStdDensity(mid) > rho) lo = mid;
+        else hi = mid;
+    }
+    return 0.5f*(lo + hi);
+}
+
+//
+// File format: native byte order and float size.  A magic number and
+// version, the rate perturbation, the four axes (min, max, n), the
+// controls (name length, name, min, max, n), then the base, rate and
+// control tables in that order.
+//
+
+static bool writeFloats(FILE* f, float* v, int n)
+{
+    return (int)fwrite(v, sizeof(float), n, f) == n;
+}
+
+static bool readFloats(FILE* f, float* v, int n)
+{
+    return (int)fread(v, sizeof(float), n, f) == n;
+}
+
+bool AeroDatabase::write(FILE* out)
+{
+    int i, version = VERSION, nc = _controls.size();
+    bool ok = fwrite(MAGIC, 1, 4, out) == 4;
+    ok = ok && fwrite(&version, sizeof(int), 1, out) == 1;
+    ok = ok && writeFloats(out, &_rateDelta, 1);
+    for(i=0; i<NAXES; i++) {
+        ok = ok && writeFloats(out, &_axes[i].min, 2);
+        ok = ok && fwrite(&_axes[i].n, sizeof(int), 1, out) == 1;
+    }
+    ok = ok && fwrite(&nc, sizeof(int), 1, out) == 1;
+    for(i=0; i<nc; i++) {
+        ControlRec* c = (ControlRec*)_controls.get(i);
+        int len = strlen(c->name);
+        ok = ok && fwrite(&len, sizeof(int), 1, out) == 1;
+        ok = ok && (int)fwrite(c->name, 1, len, out) == len;
+        ok = ok && writeFloats(out, &c->axis.min, 2);
+        ok = ok && fwrite(&c->axis.n, sizeof(int), 1, out) == 1;
+    }
+    int na = _axes[ALPHA].n;
+    ok = ok && writeFloats(out, _base, baseSize()*NCOEFS);
+    ok = ok && writeFloats(out, _rates, na*3*NCOEFS);
+    for(i=0; i<nc; i++) {
+        ControlRec* c = (ControlRec*)_controls.get(i);
+        ok = ok && writeFloats(out, c->table, na*c->axis.n*NCOEFS);
+    }
+    return ok;
+}
+
+bool AeroDatabase::read(FILE* in)
+{
+    static const int MAXN = 100000;
+    char magic[4];
+    int i, version, nc;
+    if(fread(magic, 1, 4, in) != 4 || memcmp(magic, MAGIC, 4) != 0)
+        return false;
+    if(fread(&version, sizeof(int), 1, in) != 1 || version != VERSION)
+        return false;
+    if(!readFloats(in, &_rateDelta, 1))
+        return false;
+    for(i=0; i<NAXES; i++) {
+        if(!readFloats(in, &_axes[i].min, 2)
+           || fread(&_axes[i].n, sizeof(int), 1, in) != 1
+           || _axes[i].n < 1 || _axes[i].n > MAXN)
+            return false;
+    }
+    if(fread(&nc, sizeof(int), 1, in) != 1 || nc < 0 || nc > 64)
+        return false;
+    for(i=0; i<nc; i++) {
+        int len;
+        float range[2];
+        int n;
+        if(fread(&len, sizeof(int), 1, in) != 1 || len < 0 || len > 1024)
+            return false;
+        char* name = new char[len+1];
+        bool ok = (int)fread(name, 1, len, in) == len
+            && readFloats(in, range, 2)
+            && fread(&n, sizeof(int), 1, in) == 1 && n >= 2 && n <= MAXN;
+        name[len] = 0;
+        if(ok)
+            addControl(-1, name, range[0], range[1], n);
+        delete[] name;
+        if(!ok)
+            return false;
+    }
+    int na = _axes[ALPHA].n;
+    long long total = 0;
+    if(!addTableSize(&total, na, _axes[BETA].n, _axes[SPEED].n, _axes[ALT].n)
+       || !addTableSize(&total, na, 3))
+        return false;
+    for(i=0; i<nc; i++) {
+        ControlRec* c = (ControlRec*)_controls.get(i);
+        if(!addTableSize(&total, na, c->axis.n))
+            return false;
+    }
+
+    allocTables();
+    if(!readFloats(in, _base, baseSize()*NCOEFS)
+       || !readFloats(in, _rates, na*3*NCOEFS))
+        return false;
+    for(i=0; i<nc; i++) {
+        ControlRec* c = (ControlRec*)_controls.get(i);
+        if(!readFloats(in, c->table, na*c->axis.n*NCOEFS))
+            return false;
+    }
+    return true;
+}
+
+}; // namespace yasim
@@ -0,0 +1,132 @@
+#ifndef _AERODATABASE_HPP
+#define _AERODATABASE_HPP
+
+#include <cstdio>
+
+#include "Vector.hpp"
+
+namespace yasim {
+
+class Airplane;
+
+//
+// A table of the whole-aircraft aerodynamic force and moment, and a
+// fast table-driven replacement for the per-surface summation in
+// Model::calcForces().
+//
+// All coefficients are the force (N) or moment (N*m, about the local
+// origin) divided by the dynamic pressure 0.5*rho*V^2 of the airflow
+// at the local origin, in local coordinates.  They are built up as
+//
+//   C = base(alpha, beta, speed, altitude)
+//     + sum over controls of delta(alpha, control position)
+//     + sum over p, q, r of dC/d(rate/V)(alpha) * rate/V
+//
+// where the control increments are taken at zero sideslip with all
+// other controls at zero, and the rate derivatives by central
+// differences at zero sideslip.  Because each surface's force is
+// proportional to its own dynamic pressure, the base coefficients do
+// not actually vary with speed or altitude for YASim's surfaces; one
+// point on those axes is enough and is the default.
+//
+// The runtime model sees only the airflow at the origin, so spatial
+// turbulence and rotor downwash on the surfaces are not represented,
+// and it ignores control transition times.
+//
+class AeroDatabase {
+public:
+    enum { ALPHA, BETA, SPEED, ALT, NAXES };
+    enum { FX, FY, FZ, MX, MY, MZ, NCOEFS };
+
+    AeroDatabase();
+    ~AeroDatabase();
+
+    //
+    // Generation
+    //
+
+    // Sets the grid along one of the axes: n points from min to max
+    // (radians, m/s, meters).
+    void setAxis(int axis, float min, float max, int n);
+
+    // Adds a control axis, a ControlMap input of the airplane given
+    // to generate(), tabulated at n points between min and max.  The
+    // name is stored, so the input can be found again at runtime.
+    void addControl(int input, const char* name, float min, float max,
+                    int n);
+
+    // Adds another copy of the airplane to be used as a parallel
+    // worker (see Linearizer::addClone()).
+    void addClone(Airplane* airplane);
+
+    // Fills in the tables by evaluating the surfaces of the airplane
+    // (and its clones) at every grid point.
+    void generate(Airplane* airplane);
+
+    bool write(FILE* out);
+    bool read(FILE* in);
+
+    //
+    // Runtime
+    //
+
+    int numControls() { return _controls.size(); }
+    const char* getControlName(int control);
+
+    // Sets the ControlMap input handle that feeds a control, after
+    // read().  -1 leaves the control at zero.
+    void setControlInput(int control, int input);
+
+    // Sets the value of every control fed by the given input handle,
+    // the way ControlMap::setInput() does.
+    void setInput(int input, float val);
+
+    // The coefficients for the airflow va (the "wind" at the origin,
+    // as from Model::localWind()) and the rotation rate rot, both in
+    // local coordinates.  The density is used only to find the
+    // altitude, if the table has more than one.
+    void getCoefs(float* va, float* rot, float rho, float* coefs);
+
+    // Force and moment about the origin, in local coordinates.
+    void calcForces(float* va, float* rot, float rho, float* force,
+                    float* moment);
+
+    // The grid along an axis, for reports.
+    float getAxisMin(int axis) { return _axes[axis].min; }
+    float getAxisMax(int axis) { return _axes[axis].max; }
+    int getAxisSize(int axis) { return _axes[axis].n; }
+    float getControlMin(int control);
+    float getControlMax(int control);
+
+private:
+    struct Axis { float min, max; int n; };
+    struct ControlRec { int input; char* name; Axis axis; float val;
+                        float* table; };
+    struct Worker { AeroDatabase* db; Airplane* airplane; int idx, stride; };
+
+    static void locate(Axis* a, float x, int* i0, int* i1, float* frac);
+    static float gridPoint(Axis* a, int i);
+    static float densityAltitude(float rho);
+
+    void freeTables();
+    void allocTables();
+    int baseSize();
+    void evaluate(Airplane* airplane, int eval);
+    static void runWorker(Worker* w);
+
+    Axis _axes[NAXES];
+    Vector _controls;
+    Vector _airplanes;
+
+    float* _base;  // alpha, beta, speed, altitude, coefficient
+    float* _rates; // alpha, rate axis, coefficient
+    float _rateDelta; // perturbation of rate/V, 1/m
+
+    // Generation temporaries
+    int _nevals;
+    float* _results; // reference and rate evaluations
+
+};
+
+}; // namespace yasim
+#endif // _AERODATABASE_HPP
@@ -2,6 +2,10 @@
 #  include "config.h"
 #endif
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "Atmosphere.hpp"
 #include "ControlMap.hpp"
 #include "Gear.hpp"
@@ -56,6 +60,9 @@ Airplane::Airplane()
     _cruiseAoA = 0;
     _tailIncidence = 0;
 
+    _newtonSolve = true;
+    _isSolveClone = false;
+    _solveWorkers = 0;
     _failureMsg = 0;
 }
 
@@ -247,6 +254,75 @@ void Airplane::addSolutionWeight(bool approach, int idx, float wgt)
     _solveWeights.add(w);
 }
 
+void Airplane::setApproachControl(int control, float val)
+{
+    for(int c=0; c<_solveClones.size(); c++)
+        ((Airplane*)_solveClones.get(c))->setApproachControl(control, val);
+    for(int i=0; i<_approachControls.size(); i++) {
+        Control* c = (Control*)_approachControls.get(i);
+        if(c->control == control) {
+            c->val = val;
+            return;
+        }
+    }
+    addApproachControl(control, val);
+}
+
+void Airplane::setCruiseControl(int control, float val)
+{
+    for(int c=0; c<_solveClones.size(); c++)
+        ((Airplane*)_solveClones.get(c))->setCruiseControl(control, val);
+    for(int i=0; i<_cruiseControls.size(); i++) {
+        Control* c = (Control*)_cruiseControls.get(i);
+        if(c->control == control) {
+            c->val = val;
+            return;
+        }
+    }
+    addCruiseControl(control, val);
+}
+
+void Airplane::setSolutionWeight(bool approach, int idx, float wgt)
+{
+    for(int c=0; c<_solveClones.size(); c++)
+        ((Airplane*)_solveClones.get(c))->setSolutionWeight(approach, idx, wgt);
+    for(int i=0; i<_solveWeights.size(); i++) {
+        SolveWeight* w = (SolveWeight*)_solveWeights.get(i);
+        if(w->approach == approach && w->idx == idx) {
+            w->wgt = wgt;
+            return;
+        }
+    }
+    addSolutionWeight(approach, idx, wgt);
+}
+
+void Airplane::setBallast(int handle, float* pos, float mass)
+{
+    for(int c=0; c<_solveClones.size(); c++)
+        ((Airplane*)_solveClones.get(c))->setBallast(handle, pos, mass);
+    float delta = mass - _model.getBody()->getMass(handle);
+    _model.getBody()->setMass(handle, mass, pos);
+    _ballast += delta;
+    _emptyWeight += delta;
+}
+
+void Airplane::setSolutionFuel(bool approach, float fuel)
+{
+    for(int c=0; c<_solveClones.size(); c++)
+        ((Airplane*)_solveClones.get(c))->setSolutionFuel(approach, fuel);
+    if(approach) _approachFuel = fuel;
+    else         _cruiseFuel = fuel;
+}
+
+void Airplane::setSolutionCruise(float speed, float altitude)
+{
+    for(int c=0; c<_solveClones.size(); c++)
+        ((Airplane*)_solveClones.get(c))->setSolutionCruise(speed, altitude);
+    _cruiseSpeed = speed;
+    _cruiseP = Atmosphere::getStdPressure(altitude);
+    _cruiseT = Atmosphere::getStdTemperature(altitude);
+}
+
 int Airplane::numTanks()
 {
     return _tanks.size();
@@ -357,10 +433,10 @@ void Airplane::addThruster(Thruster* thruster, float mass, float* cg)
     _thrusters.add(t);
 }
 
-void Airplane::addBallast(float* pos, float mass)
+int Airplane::addBallast(float* pos, float mass)
 {
-    _model.getBody()->addMass(mass, pos);
     _ballast += mass;
+    return _model.getBody()->addMass(mass, pos);
 }
 
 int Airplane::addWeight(float* pos, float size)
@@ -371,7 +447,7 @@ int Airplane::addWeight(float* pos, float size)
     wr->surf = new Surface();
     wr->surf->setPosition(pos);
     wr->surf->setTotalDrag(size*size);
-    _model.addSurface(wr->surf);
+    _model.addSurface(wr->surf, ForceBreakdown::WEIGHT_DRAG);
     _surfs.add(wr->surf);
 
     return _weights.add(wr);
@@ -465,7 +541,7 @@ void Airplane::addContactPoint(float* pos)
     _contacts.add(c);
 }
 
-float Airplane::compileWing(Wing* w)
+float Airplane::compileWing(Wing* w, int category)
 {
     // The tip of the wing is a contact point
     float tip[3];
@@ -489,7 +565,7 @@ float Airplane::compileWing(Wing* w)
 	float td = s->getTotalDrag();
 	s->setTotalDrag(td);
 
-        _model.addSurface(s);
+        _model.addSurface(s, category);
 
         float mass = w->getSurfaceWeight(i);
         mass = mass * Math::sqrt(mass);
@@ -562,7 +638,7 @@ float Airplane::compileFuselage(Fuselage* f)
 	Math::cross3(z, x, y);
         s->setOrientation(o);
 
-        _model.addSurface(s);
+        _model.addSurface(s, ForceBreakdown::FUSELAGE);
         _surfs.add(s);
     }
     return wgt;
@@ -592,7 +668,7 @@ void Airplane::compileGear(GearRec* gr)
     s->setTotalDrag(length*length);
 
     _model.addGear(g);
-    _model.addSurface(s);
+    _model.addSurface(s, ForceBreakdown::GEAR_DRAG);
     _surfs.add(s);
 }
 
@@ -643,12 +719,13 @@ void Airplane::compile()
 
     // The Wing objects
     if (_wing)
-      aeroWgt += compileWing(_wing);
+      aeroWgt += compileWing(_wing, ForceBreakdown::WING);
     if (_tail)
-      aeroWgt += compileWing(_tail);
+      aeroWgt += compileWing(_tail, ForceBreakdown::TAIL);
     int i;
     for(i=0; i<_vstabs.size(); i++)
-        aeroWgt += compileWing((Wing*)_vstabs.get(i)); 
+        aeroWgt += compileWing((Wing*)_vstabs.get(i),
+                               ForceBreakdown::vstab(i));
 
 
     // The fuselage(s)
@@ -672,14 +749,11 @@ void Airplane::compile()
     }
 
     // Add the tanks, empty for now.
-    float totalFuel = 0;
     for(i=0; i<_tanks.size(); i++) { 
         Tank* t = (Tank*)_tanks.get(i); 
         t->handle = body->addMass(0, t->pos);
-        totalFuel += t->cap;
     }
-    _cruiseWeight = _emptyWeight + totalFuel*_cruiseFuel;
-    _approachWeight = _emptyWeight + totalFuel*_approachFuel;
+    calcSolutionWeights();
 
     body->recalc();
 
@@ -706,7 +780,18 @@ void Airplane::compile()
     if (_failureMsg) return;
 
     solveGear();
-    if(_wing && _tail) solve();
+
+    // A clone stops here; the original's solve() sets it up for each
+    // evaluation.
+    if(_isSolveClone) return;
+    for(i=0; i<_solveClones.size(); i++)
+        ((Airplane*)_solveClones.get(i))->compile();
+
+    if(_wing && _tail) {
+        startSolveWorkers();
+        solve();
+        stopSolveWorkers();
+    }
     else
     {
        // The rotor(s) mass:
@@ -719,6 +804,25 @@ void Airplane::compile()
     compileContactPoints();
 }
 
+void Airplane::resolve()
+{
+    if(!_wing || !_tail)
+        return;
+    calcSolutionWeights();
+    startSolveWorkers();
+    solve();
+    stopSolveWorkers();
+}
+
+void Airplane::calcSolutionWeights()
+{
+    float totalFuel = 0;
+    for(int i=0; i<_tanks.size(); i++)
+        totalFuel += ((Tank*)_tanks.get(i))->cap;
+    _cruiseWeight = _emptyWeight + totalFuel*_cruiseFuel;
+    _approachWeight = _emptyWeight + totalFuel*_approachFuel;
+}
+
 void Airplane::solveGear()
 {
     float cg[3], pos[3];
@@ -843,6 +947,19 @@ void Airplane::runCruise()
     _model.calcForces(&_cruiseState);
 }
 
+State* Airplane::setupCruise()
+{
+    runCruise();
+    return &_cruiseState;
+}
+
+void Airplane::getCruiseControl(int i, int* control, float* val)
+{
+    Control* c = (Control*)_cruiseControls.get(i);
+    *control = c->control;
+    *val = c->val;
+}
+
 void Airplane::runApproach()
 {
     setupState(_approachAoA, _approachSpeed,_approachGlideAngle, &_approachState);
@@ -889,7 +1006,15 @@ void Airplane::runApproach()
 
 void Airplane::applyDragFactor(float factor)
 {
-    float applied = Math::pow(factor, SOLVE_TWEAK);
+    scaleDrag(Math::pow(factor, SOLVE_TWEAK));
+}
+
+void Airplane::scaleDrag(float applied)
+{
+    // The clones follow every step, so their drag is always exactly
+    // the same as ours.
+    for(int c=0; c<_solveClones.size(); c++)
+        ((Airplane*)_solveClones.get(c))->scaleDrag(applied);
     _dragFactor *= applied;
     if(_wing)
       _wing->setDragScale(_wing->getDragScale() * applied);
@@ -908,7 +1033,13 @@ void Airplane::applyDragFactor(float factor)
 
 void Airplane::applyLiftRatio(float factor)
 {
-    float applied = Math::pow(factor, SOLVE_TWEAK);
+    scaleLift(Math::pow(factor, SOLVE_TWEAK));
+}
+
+void Airplane::scaleLift(float applied)
+{
+    for(int c=0; c<_solveClones.size(); c++)
+        ((Airplane*)_solveClones.get(c))->scaleLift(applied);
     _liftRatio *= applied;
     if(_wing)
       _wing->setLiftRatio(_wing->getLiftRatio() * applied);
@@ -939,59 +1070,60 @@ void Airplane::solve()
 {
     static const float ARCMIN = 0.0002909f;
 
-    float tmp[3];
     _solutionIterations = 0;
     _failureMsg = 0;
 
+    // Get close with the quasi-Newton solver first, if we can.  The
+    // loop below then starts at the solution and only has to confirm
+    // it.
+    if(_newtonSolve)
+        solveNewton();
+
     while(1) {
         if(_solutionIterations++ > 10000) { 
             _failureMsg = "Solution failed to converge after 10000 iterations";
             return;
         }
 
-	// Run an iteration at cruise, and extract the needed numbers:
-	runCruise();
-
-	_model.getThrust(tmp);
-        float thrust = tmp[0] + _cruiseWeight * Math::sin(_cruiseGlideAngle) * 9.81;
-
-	_model.getBody()->getAccel(tmp);
-        Math::tmul33(_cruiseState.orient, tmp, tmp);
-	float xforce = _cruiseWeight * tmp[0];
-	float clift0 = _cruiseWeight * tmp[2];
-
-	_model.getBody()->getAngularAccel(tmp);
-        Math::tmul33(_cruiseState.orient, tmp, tmp);
-	float pitch0 = tmp[1];
-
-	// Run an approach iteration, and do likewise
-	runApproach();
-
-	_model.getBody()->getAngularAccel(tmp);
-        Math::tmul33(_approachState.orient, tmp, tmp);
-	double apitch0 = tmp[1];
-
-	_model.getBody()->getAccel(tmp);
-        Math::tmul33(_approachState.orient, tmp, tmp);
-	float alift = _approachWeight * tmp[2];
-
-	// Modify the cruise AoA a bit to get a derivative
-	_cruiseAoA += ARCMIN;
-	runCruise();
-	_cruiseAoA -= ARCMIN;
-
-	_model.getBody()->getAccel(tmp);
-        Math::tmul33(_cruiseState.orient, tmp, tmp);
-	float clift1 = _cruiseWeight * tmp[2];
-
-	// Do the same with the tail incidence
-	_tail->setIncidence(_tailIncidence + ARCMIN);
-	runCruise();
-	_tail->setIncidence(_tailIncidence);
-
-	_model.getBody()->getAngularAccel(tmp);
-        Math::tmul33(_cruiseState.orient, tmp, tmp);
-	float pitch1 = tmp[1];
+	// The five evaluations of an iteration are independent of each
+	// other, and run in parallel when there are clones: cruise and
+	// approach at the current values, then cruise with the AoA and
+	// with the tail incidence moved a bit, and approach with the
+	// elevator moved, to get derivatives.  The incidence actually set
+	// on the tail lags _tailIncidence by an iteration, as it always
+	// has.  The variables are put back the way the serial code left
+	// them.
+        const float ELEVDIDDLE = 0.001f;
+        float tail0 = _tail->getIncidence();
+        float elev0 = _approachElevator.val;
+        float aoa1 = _cruiseAoA + ARCMIN;
+        float elev1 = elev0 + ELEVDIDDLE;
+        float aoaR = aoa1 - ARCMIN;
+        SolveRun runs[5] = {
+            { false, _cruiseAoA, tail0, elev0 },
+            { true,  _cruiseAoA, tail0, elev0 },
+            { false, aoa1, tail0, elev0 },
+            { false, aoaR, _tailIncidence + ARCMIN, elev0 },
+            { true,  aoaR, _tailIncidence, elev1 } };
+        runSolves(runs, 5);
+        _cruiseAoA = aoaR;
+        _tail->setIncidence(_tailIncidence);
+        _approachElevator.val = elev1 - ELEVDIDDLE;
+
+	// Cruise
+        float thrust = runs[0].thrust[0] + _cruiseWeight * Math::sin(_cruiseGlideAngle) * 9.81;
+	float xforce = _cruiseWeight * runs[0].accel[0];
+	float clift0 = _cruiseWeight * runs[0].accel[2];
+	float pitch0 = runs[0].rot[1];
+
+	// Approach
+	double apitch0 = runs[1].rot[1];
+	float alift = _approachWeight * runs[1].accel[2];
+
+	// The derivatives
+	float clift1 = _cruiseWeight * runs[2].accel[2];
+	float pitch1 = runs[3].rot[1];
+	double apitch1 = runs[4].rot[1];
 
 	// Now calculate:
 	float awgt = 9.8f * _approachWeight;
@@ -1009,14 +1141,6 @@ void Airplane::solve()
         // like the tail incidence computation (it's solving for the
         // same thing -- pitching moment -- by diddling a different
         // variable).
-        const float ELEVDIDDLE = 0.001f;
-        _approachElevator.val += ELEVDIDDLE;
-        runApproach();
-        _approachElevator.val -= ELEVDIDDLE;
-
-	_model.getBody()->getAngularAccel(tmp);
-        Math::tmul33(_approachState.orient, tmp, tmp);
-	double apitch1 = tmp[1];
         float elevDelta = -apitch0 * (ELEVDIDDLE/(apitch1-apitch0));
 
         // Now apply the values we just computed.  Note that the
@@ -1073,6 +1197,503 @@ void Airplane::solve()
     }
 }
 
+// The variables of solveNewton(): the logs of the drag factor and
+// lift ratio, the cruise AoA, the tail incidence and the approach
+// elevator.
+void Airplane::getTrimVars(float* x)
+{
+    x[0] = (float)::log(_dragFactor);
+    x[1] = (float)::log(_liftRatio);
+    x[2] = _cruiseAoA;
+    x[3] = _tailIncidence;
+    x[4] = _approachElevator.val;
+}
+
+void Airplane::setTrimVars(float* x)
+{
+    if(x[0] != (float)::log(_dragFactor))
+        scaleDrag(Math::exp(x[0]) / _dragFactor);
+    if(x[1] != (float)::log(_liftRatio))
+        scaleLift(Math::exp(x[1]) / _liftRatio);
+    _cruiseAoA = x[2];
+    _tailIncidence = x[3];
+    _tail->setIncidence(_tailIncidence);
+    _approachElevator.val = x[4];
+}
+
+// The quantities solve() drives to zero, as accelerations: cruise X,
+// approach Z, cruise Z, cruise pitch and approach pitch.
+void Airplane::trimResiduals(float* r)
+{
+    float elev = _approachElevator.val;
+    SolveRun runs[2] = {
+        { false, _cruiseAoA, _tailIncidence, elev },
+        { true,  _cruiseAoA, _tailIncidence, elev } };
+    runSolves(runs, 2);
+    _tail->setIncidence(_tailIncidence);
+    r[0] = runs[0].accel[0];
+    r[1] = runs[1].accel[2];
+    r[2] = runs[0].accel[2];
+    r[3] = runs[0].rot[1];
+    r[4] = runs[1].rot[1];
+}
+
+// Forward difference Jacobian of the residuals r at x, row major.
+// Leaves the variables at x.  The drag and lift columns change the
+// airplane (and clones), so are done one at a time; the other three
+// are one batch of runs.
+void Airplane::trimJacobian(float* x, float* r, float* jac)
+{
+    static const float STEP[NTRIM] = { 1e-3f, 1e-3f, 0.0002909f,
+                                       0.0002909f, 0.001f };
+    float xp[NTRIM], rp[NTRIM];
+    int i, j;
+    for(j=0; j<2; j++) {
+        for(i=0; i<NTRIM; i++) xp[i] = x[i];
+        xp[j] += STEP[j];
+        setTrimVars(xp);
+        trimResiduals(rp);
+        for(i=0; i<NTRIM; i++)
+            jac[i*NTRIM+j] = (rp[i] - r[i]) / STEP[j];
+    }
+    setTrimVars(x);
+
+    SolveRun runs[6];
+    for(j=2; j<NTRIM; j++) {
+        for(i=0; i<NTRIM; i++) xp[i] = x[i];
+        xp[j] += STEP[j];
+        for(i=0; i<2; i++) {
+            SolveRun* run = &runs[2*(j-2) + i];
+            run->approach = i == 1;
+            run->aoa = xp[2];
+            run->tail = xp[3];
+            run->elev = xp[4];
+        }
+    }
+    runSolves(runs, 6);
+    _tail->setIncidence(_tailIncidence);
+    for(j=2; j<NTRIM; j++) {
+        SolveRun* c = &runs[2*(j-2)];
+        SolveRun* a = c + 1;
+        rp[0] = c->accel[0];
+        rp[1] = a->accel[2];
+        rp[2] = c->accel[2];
+        rp[3] = c->rot[1];
+        rp[4] = a->rot[1];
+        for(i=0; i<NTRIM; i++)
+            jac[i*NTRIM+j] = (rp[i] - r[i]) / STEP[j];
+    }
+}
+
+// The shared state of the solver's worker threads, one per clone.
+// The workers wait for a new batch of runs, each takes every n'th
+// one, and the last to finish wakes the caller.
+struct SolveWorkers {
+    std::mutex lock;
+    std::condition_variable start, done;
+    Airplane* airplane;
+    std::thread* threads;
+    int nthreads;
+    int batch;     // incremented for each batch
+    int pending;   // workers not yet done with it
+    bool quit;
+    Airplane::SolveRun* runs;
+    int nruns;
+};
+
+void Airplane::solveWorker(SolveWorkers* w, int idx)
+{
+    Airplane* a = (Airplane*)w->airplane->_solveClones.get(idx-1);
+    int stride = w->nthreads + 1;
+    int seen = 0;
+    while(1) {
+        {
+            std::unique_lock<std::mutex> l(w->lock);
+            while(w->batch == seen && !w->quit)
+                w->start.wait(l);
+            if(w->quit) return;
+            seen = w->batch;
+        }
+        for(int i=idx; i<w->nruns; i+=stride)
+            a->runSolve(&w->runs[i]);
+        std::lock_guard<std::mutex> l(w->lock);
+        if(--w->pending == 0)
+            w->done.notify_one();
+    }
+}
+
+Airplane::SolveRun::SolveRun(bool approach, float aoa, float tail, float elev)
+{
+    this->approach = approach;
+    this->aoa = aoa;
+    this->tail = tail;
+    this->elev = elev;
+    for(int i=0; i<3; i++)
+        thrust[i] = accel[i] = rot[i] = 0;
+}
+
+// Runs one evaluation on this airplane.  The variables of this
+// airplane are left as the run set them.
+void Airplane::runSolve(SolveRun* r)
+{
+    State* s;
+    _cruiseAoA = r->aoa;
+    _tail->setIncidence(r->tail);
+    _approachElevator.val = r->elev;
+    if(r->approach) {
+        runApproach();
+        s = &_approachState;
+    } else {
+        runCruise();
+        s = &_cruiseState;
+    }
+    _model.getThrust(r->thrust);
+    _model.getBody()->getAccel(r->accel);
+    Math::tmul33(s->orient, r->accel, r->accel);
+    _model.getBody()->getAngularAccel(r->rot);
+    Math::tmul33(s->orient, r->rot, r->rot);
+}
+
+// Runs a batch of evaluations, spread over this airplane and its
+// clones.  Each copy is in the same state, so the results don't
+// depend on which one does which run.
+void Airplane::runSolves(SolveRun* runs, int n)
+{
+    int i;
+    SolveWorkers* w = _solveWorkers;
+    if(!w) {
+        for(i=0; i<n; i++)
+            runSolve(&runs[i]);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> l(w->lock);
+        w->runs = runs;
+        w->nruns = n;
+        w->pending = w->nthreads;
+        w->batch++;
+    }
+    w->start.notify_all();
+    for(i=0; i<n; i+=w->nthreads+1)
+        runSolve(&runs[i]);
+    std::unique_lock<std::mutex> l(w->lock);
+    while(w->pending)
+        w->done.wait(l);
+}
+
+// The worker threads for the clones last for the whole solve.
+void Airplane::startSolveWorkers()
+{
+    if(!_solveClones.size())
+        return;
+    SolveWorkers* w = new SolveWorkers();
+    w->airplane = this;
+    w->nthreads = _solveClones.size();
+    w->threads = new std::thread[w->nthreads];
+    w->batch = w->pending = 0;
+    w->quit = false;
+    w->runs = 0;
+    w->nruns = 0;
+    for(int i=0; i<w->nthreads; i++)
+        w->threads[i] = std::thread(solveWorker, w, i+1);
+    _solveWorkers = w;
+}
+
+void Airplane::stopSolveWorkers()
+{
+    SolveWorkers* w = _solveWorkers;
+    if(!w)
+        return;
+    {
+        std::lock_guard<std::mutex> l(w->lock);
+        w->quit = true;
+    }
+    w->start.notify_all();
+    for(int i=0; i<w->nthreads; i++)
+        w->threads[i].join();
+    delete[] w->threads;
+    delete w;
+    _solveWorkers = 0;
+}
+
+void Airplane::addSolveClone(Airplane* clone)
+{
+    clone->_isSolveClone = true;
+    _solveClones.add(clone);
+}
+
+// Solves a*x = b for x, in place in b, by Gaussian elimination with
+// partial pivoting.  Destroys a.  Returns false if a is singular.
+static bool solveLinear(float* a, float* b, int n)
+{
+    int i, j, k;
+    for(k=0; k<n; k++) {
+        int p = k;
+        for(i=k+1; i<n; i++)
+            if(Math::abs(a[i*n+k]) > Math::abs(a[p*n+k])) p = i;
+        if(a[p*n+k] == 0)
+            return false;
+        if(p != k) {
+            for(j=0; j<n; j++) {
+                float t = a[k*n+j]; a[k*n+j] = a[p*n+j]; a[p*n+j] = t;
+            }
+            float t = b[k]; b[k] = b[p]; b[p] = t;
+        }
+        for(i=k+1; i<n; i++) {
+            float f = a[i*n+k] / a[k*n+k];
+            for(j=k; j<n; j++) a[i*n+j] -= f * a[k*n+j];
+            b[i] -= f * b[k];
+        }
+    }
+    for(k=n-1; k>=0; k--) {
+        for(j=k+1; j<n; j++) b[k] -= a[k*n+j] * b[j];
+        b[k] /= a[k*n+k];
+    }
+    return true;
+}
+
+// Solves for all five variables of the fixed-point iteration in
+// solve() at once, with Broyden's method: the Jacobian is found by
+// finite differences at the start, and then updated from each step
+// taken, so each iteration costs just one cruise and one approach
+// run.  Steps are limited in size, and halved until they reduce the
+// residuals; when that fails the Jacobian is found again.  Converged
+// once the step is a tenth of solve()'s tolerances.  Returns false,
+// with the variables back where they started, if it can't get
+// there.
+bool Airplane::solveNewton()
+{
+    static const int MAXITER = 100;
+    static const float TOL[NTRIM] = { 1e-5f, 1e-5f, 1.7e-6f, 1.7e-6f, 1e-5f };
+    static const float MAXSTEP[NTRIM] = { 0.5f, 0.5f, 0.02f, 0.02f, 0.1f };
+    float x0[NTRIM], x[NTRIM], r[NTRIM], xn[NTRIM], rn[NTRIM], dx[NTRIM];
+    float jac[NTRIM*NTRIM], a[NTRIM*NTRIM], wgt[NTRIM];
+    int i, j, iter;
+
+    getTrimVars(x0);
+    getTrimVars(x);
+    trimResiduals(r);
+    trimJacobian(x, r, jac);
+    bool fresh = true;
+
+    // Each residual is weighed by how far it moves for a tolerance's
+    // change in "its" variable, the one solve() adjusts for it.
+    for(i=0; i<NTRIM; i++) {
+        float d = Math::abs(jac[i*NTRIM+i]) * TOL[i];
+        wgt[i] = d > 0 ? 1/d : 1;
+    }
+    float merit = 0;
+    for(i=0; i<NTRIM; i++) merit += Math::sqr(wgt[i]*r[i]);
+
+    for(iter=0; iter<MAXITER; iter++) {
+        _solutionIterations++;
+
+        // The Newton step, limited in size
+        for(i=0; i<NTRIM*NTRIM; i++) a[i] = jac[i];
+        for(i=0; i<NTRIM; i++) dx[i] = -r[i];
+        bool ok = solveLinear(a, dx, NTRIM);
+        float scale = 1;
+        for(i=0; ok && i<NTRIM; i++) {
+            if(dx[i] != dx[i]) ok = false;
+            else if(Math::abs(dx[i]) * scale > MAXSTEP[i])
+                scale = MAXSTEP[i] / Math::abs(dx[i]);
+        }
+        bool converged = ok;
+        for(i=0; ok && i<NTRIM; i++) {
+            dx[i] *= scale;
+            if(Math::abs(dx[i]) > TOL[i]) converged = false;
+        }
+
+        // Back off until the residuals drop (or are all within
+        // tolerance anyway).
+        float nmerit = merit;
+        bool better = false;
+        for(j=0; ok && j<8 && !better; j++) {
+            for(i=0; i<NTRIM; i++) xn[i] = x[i] + dx[i];
+            xn[2] = clamp(xn[2], -0.175f, 0.175f);
+            xn[3] = clamp(xn[3], -0.175f, 0.175f);
+            setTrimVars(xn);
+            trimResiduals(rn);
+            nmerit = 0;
+            for(i=0; i<NTRIM; i++) nmerit += Math::sqr(wgt[i]*rn[i]);
+            better = nmerit < merit || nmerit < NTRIM;
+            if(!better)
+                for(i=0; i<NTRIM; i++) dx[i] *= 0.5f;
+        }
+
+        if(!better) {
+            if(fresh) break;
+            setTrimVars(x);
+            trimJacobian(x, r, jac);
+            fresh = true;
+            continue;
+        }
+
+        // Broyden's update: jac += (dr - jac*dx) dx' / (dx' dx)
+        float dd = 0;
+        for(i=0; i<NTRIM; i++) {
+            dx[i] = xn[i] - x[i];
+            dd += dx[i]*dx[i];
+        }
+        for(i=0; dd > 0 && i<NTRIM; i++) {
+            float u = rn[i] - r[i];
+            for(j=0; j<NTRIM; j++) u -= jac[i*NTRIM+j] * dx[j];
+            for(j=0; j<NTRIM; j++) jac[i*NTRIM+j] += u * dx[j] / dd;
+        }
+        fresh = false;
+
+        for(i=0; i<NTRIM; i++) { x[i] = xn[i]; r[i] = rn[i]; }
+        merit = nmerit;
+        if(converged)
+            return true;
+    }
+
+    setTrimVars(x0);
+    return false;
+}
+
+// The unknowns of trim(): AoA, sideslip and the inputs, and for each
+// the acceleration it mostly controls (x, y, z, then the angular ones).
+static const int TRIM_NX = 2 + Airplane::NTRIMINPUTS;
+static const int TRIM_RES[TRIM_NX] = { 2, 1, 0, 4, 3, 5 };
+
+bool Airplane::trim(float speed, float altitude, float gamma, float bank,
+                    float hdg, const int* inputs, float* vals)
+{
+    static const int MAXITER = 50;
+    static const float TOL[6] = { 0.01f, 0.01f, 0.01f,     // m/s^2
+                                  0.001f, 0.001f, 0.001f }; // rad/s^2
+    static const float DELTA[TRIM_NX] = { 0.002f, 0.002f, 0.02f, 0.01f,
+                                          0.01f, 0.01f };
+    static const float MAXSTEP[TRIM_NX] = { 0.05f, 0.05f, 0.2f, 0.2f,
+                                            0.2f, 0.2f };
+    static const float MIN[TRIM_NX] = { -0.5f, -0.5f, 0, -1, -1, -1 };
+    static const float MAX[TRIM_NX] = { 0.5f, 0.5f, 1, 1, 1, 1 };
+    int i, j, k;
+
+    // The local frame at the airplane's position, and the
+    // orientation of the airflow in it.  A body orientation is this
+    // turned through the AoA and sideslip.
+    TrimPoint tp;
+    State* s = _model.getState();
+    for(i=0; i<3; i++) tp.pos[i] = s->pos[i];
+    float up[3], xyz2ned[9], tmp[3];
+    Glue::geodUp(tp.pos, up);
+    Glue::xyz2nedMat(Math::asin(up[2]), Math::atan2(up[1], up[0]), xyz2ned);
+    Glue::euler2orient(bank, gamma, hdg, tp.orient);
+    Math::mmul33(tp.orient, xyz2ned, tp.orient);
+
+    tmp[0] = speed; tmp[1] = tmp[2] = 0;
+    Math::tmul33(tp.orient, tmp, tp.v);
+    tmp[0] = tmp[1] = 0; tmp[2] = 9.8f * Math::tan(bank) / speed;
+    Math::tmul33(xyz2ned, tmp, tp.rot);
+
+    tp.P = Atmosphere::getStdPressure(altitude);
+    tp.T = Atmosphere::getStdTemperature(altitude);
+    tp.rho = Atmosphere::getStdDensity(altitude);
+    tp.inputs = inputs;
+    float wind[3] = { 0, 0, 0 };
+    _model.setWind(wind);
+    _model.setAir(tp.P, tp.T, tp.rho);
+
+    // The unknowns in use: both angles, and the inputs we have.
+    int var[TRIM_NX], n = 0;
+    float x[TRIM_NX], xp[TRIM_NX], r[6], rp[6];
+    float jac[TRIM_NX*TRIM_NX], dx[TRIM_NX];
+    x[0] = x[1] = 0;
+    for(i=0; i<TRIM_NX; i++) {
+        if(i >= 2) x[i] = vals[i-2];
+        if(i < 2 || inputs[i-2] >= 0) var[n++] = i;
+    }
+
+    for(int iter=0; iter<MAXITER; iter++) {
+        trimState(&tp, x, r);
+        bool done = true;
+        for(i=0; i<n; i++) {
+            int ri = TRIM_RES[var[i]];
+            if(Math::abs(r[ri]) > TOL[ri]) done = false;
+        }
+        if(done) {
+            for(i=0; i<NTRIMINPUTS; i++) vals[i] = x[i+2];
+            return true;
+        }
+
+        // The Jacobian, one-sided, and the Newton step, limited in
+        // size and kept in the inputs' range
+        for(j=0; j<n; j++) {
+            for(k=0; k<TRIM_NX; k++) xp[k] = x[k];
+            xp[var[j]] += DELTA[var[j]];
+            trimState(&tp, xp, rp);
+            for(i=0; i<n; i++) {
+                int ri = TRIM_RES[var[i]];
+                jac[i*n+j] = (rp[ri] - r[ri]) / DELTA[var[j]];
+            }
+        }
+        for(i=0; i<n; i++) dx[i] = -r[TRIM_RES[var[i]]];
+        if(!solveLinear(jac, dx, n))
+            break;
+        float scale = 1;
+        for(i=0; i<n; i++) {
+            if(dx[i] != dx[i]) return false;
+            if(Math::abs(dx[i]) * scale > MAXSTEP[var[i]])
+                scale = MAXSTEP[var[i]] / Math::abs(dx[i]);
+        }
+        for(i=0; i<n; i++) {
+            int v = var[i];
+            x[v] = clamp(x[v] + scale*dx[i], MIN[v], MAX[v]);
+        }
+    }
+    return false;
+}
+
+void Airplane::trimState(TrimPoint* tp, float* x, float* r)
+{
+    int i;
+    for(i=0; i<NTRIMINPUTS; i++)
+        if(tp->inputs[i] >= 0)
+            _controls.setInput(tp->inputs[i], x[i+2]);
+    _controls.applyControls(1000000); // Huge dt value
+
+    // The body is the airflow's frame turned through the sideslip and
+    // the AoA.
+    float ca = Math::cos(x[0]), sa = Math::sin(x[0]);
+    float cb = Math::cos(x[1]), sb = Math::sin(x[1]);
+    float turn[9] = {  ca*cb, ca*sb,  sa,
+                         -sb,    cb,   0,
+                      -sa*cb, -sa*sb, ca };
+    State s;
+    for(i=0; i<3; i++) s.pos[i] = tp->pos[i];
+    Math::mmul33(turn, tp->orient, s.orient);
+    Math::set3(tp->v, s.v);
+    Math::set3(tp->rot, s.rot);
+    _model.setState(&s);
+    State* ms = _model.getState();
+
+    float lv[3], lrot[3], wind[3], tmp[3];
+    Math::vmul33(ms->orient, ms->v, lv);
+    Math::vmul33(ms->orient, ms->rot, lrot);
+    Math::mul3(-1, lv, wind);
+    for(i=0; i<_thrusters.size(); i++) {
+        Thruster* t = ((ThrustRec*)_thrusters.get(i))->thruster;
+        t->setWind(wind);
+        t->setAir(tp->P, tp->T, tp->rho);
+    }
+    stabilizeThrust();
+
+    updateGearState();
+    _model.getBody()->recalc();
+    _model.getBody()->reset();
+    _model.initIteration(1.0/30);
+    _model.calcForces(ms);
+
+    // Steady flight is no acceleration in the rotating body frame:
+    // the linear one is just what it takes to turn the velocity.
+    _model.getBody()->getAccel(r);
+    _model.getBody()->getAngularAccel(r+3);
+    Math::cross3(lrot, lv, tmp);
+    Math::sub3(r, tmp, r);
+}
+
 void Airplane::solveHelicopter()
 {
     _solutionIterations = 0;
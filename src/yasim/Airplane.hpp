@@ -14,8 +14,10 @@ class Hook;
 class Launchbar;
 class Thruster;
 class Hitch;
+struct SolveWorkers;
 
 class Airplane {
+    friend struct SolveWorkers;
 public:
     Airplane();
     ~Airplane();
@@ -34,6 +36,7 @@ public:
     void setWeight(float weight);
 
     void setWing(Wing* wing);
+    Wing* getWing() { return _wing; }
     void setTail(Wing* tail);
     void addVStab(Wing* vstab);
 
@@ -45,7 +48,7 @@ public:
     void addHook(Hook* h);
     void addLaunchbar(Launchbar* l);
     void addThruster(Thruster* t, float mass, float* cg);
-    void addBallast(float* pos, float mass);
+    int addBallast(float* pos, float mass);
     void addHitch(Hitch* h);
 
     int addWeight(float* pos, float size);
@@ -60,6 +63,20 @@ public:
 
     void addSolutionWeight(bool approach, int idx, float wgt);
 
+    // Changes to the solution conditions after compile(), for
+    // resolve().  The controls and weights replace any earlier setting
+    // of the same control or weight (or add one).  A ballast handle is
+    // what addBallast() returned; changing its mass changes the empty
+    // weight with it.  The fuel is the fraction loaded for the approach
+    // or cruise.  The cruise speed (m/s) and altitude (m) replace those
+    // of setCruise().
+    void setApproachControl(int control, float val);
+    void setCruiseControl(int control, float val);
+    void setSolutionWeight(bool approach, int idx, float wgt);
+    void setBallast(int handle, float* pos, float mass);
+    void setSolutionFuel(bool approach, float fuel);
+    void setSolutionCruise(float speed, float altitude);
+
     int numGear();
     Gear* getGear(int g);
     Hook* getHook();
@@ -79,7 +96,28 @@ public:
     float getFuelDensity(int tank); // kg/m^3
     float getTankCapacity(int tank);
 
+    // Uses a quasi-Newton solver to get close to the solution before
+    // the fixed-point iteration (the default), or the fixed-point
+    // iteration alone.
+    void setNewtonSolver(bool newton) { _newtonSolve = newton; }
+
+    // Adds another copy of the airplane, loaded from the same
+    // definition but not yet compiled, for the solver to run its
+    // cruise and approach evaluations on in parallel, one thread per
+    // copy.  compile() compiles the copies as far as the solver needs
+    // them; they are of no use for anything else, and can be deleted
+    // once it returns unless resolve() is to be used.  The solution is
+    // the same whatever the number of copies.
+    void addSolveClone(Airplane* clone);
+
     void compile(); // generate point masses & such, then solve
+
+    // Solves again after compile(), for the changes above, starting
+    // from the current solution rather than from scratch.  Small
+    // changes take a few iterations.  Any solve clones must still be
+    // around.  Helicopters have nothing to re-solve.
+    void resolve();
+
     void initEngines();
     void stabilizeThrust();
 
@@ -94,6 +132,30 @@ public:
 
     static void setupState(float aoa, float speed, float gla, State* s); // utility
 
+    // The inputs trim() solves for, as ControlMap input handles
+    enum { TRIM_THROTTLE, TRIM_ELEVATOR, TRIM_AILERON, TRIM_RUDDER,
+           NTRIMINPUTS };
+
+    // Trims the compiled airplane for steady flight in still air, at a
+    // true airspeed (m/s) and altitude (m), and a flight path angle,
+    // bank and heading (radians), turning at the rate that makes the
+    // bank coordinated.  Newton's method over Model::calcForces()
+    // finds the angles of attack and sideslip and the values of the
+    // inputs, NTRIMINPUTS handles of which any can be -1 for none.
+    // vals holds the starting values and gets the solution; other
+    // inputs keep whatever they were last set to.  The position stays
+    // that of the Model's state.  On success, the Model is left in the
+    // trimmed state with the engines stabilized, ready to run.
+    bool trim(float speed, float altitude, float gamma, float bank,
+              float hdg, const int* inputs, float* vals);
+
+    // The solved cruise condition, for analysis tools.  Puts the
+    // model into the cruise configuration (air, controls, weights and
+    // stabilized thrust) and returns the trimmed state.
+    State* setupCruise();
+    int numCruiseControls() { return _cruiseControls.size(); }
+    void getCruiseControl(int i, int* control, float* val);
+
 private:
     struct Tank { float pos[3]; float cap; float fill;
 	          float density; int handle; };
@@ -109,14 +171,44 @@ private:
     void runCruise();
     void runApproach();
     void solveGear();
+    void calcSolutionWeights();
     void solve();
+    bool solveNewton();
+    void getTrimVars(float* x);
+    void setTrimVars(float* x);
+    void trimResiduals(float* r);
+    void trimJacobian(float* x, float* r, float* jac);
+
+    // One cruise or approach evaluation for solve(), which can be run
+    // on any copy of the airplane: the variables, and the resulting
+    // thrust and accelerations in the flight frame (zero until run).
+    struct SolveRun {
+        SolveRun(bool approach=false, float aoa=0, float tail=0,
+                 float elev=0);
+        bool approach; float aoa, tail, elev;
+        float thrust[3], accel[3], rot[3];
+    };
+    void runSolve(SolveRun* r);
+
+    // The flight condition for trim(), and one evaluation of it: the
+    // angles of attack and sideslip and the NTRIMINPUTS inputs, and
+    // the resulting accelerations, linear then angular.
+    struct TrimPoint { double pos[3]; float orient[9]; float v[3], rot[3];
+                       float P, T, rho; const int* inputs; };
+    void trimState(TrimPoint* tp, float* x, float* r);
+    void runSolves(SolveRun* runs, int n);
+    static void solveWorker(SolveWorkers* w, int idx);
+    void startSolveWorkers();
+    void stopSolveWorkers();
     void solveHelicopter();
-    float compileWing(Wing* w);
+    float compileWing(Wing* w, int category);
     void compileRotorgear();
     float compileFuselage(Fuselage* f);
     void compileGear(GearRec* gr);
     void applyDragFactor(float factor);
     void applyLiftRatio(float factor);
+    void scaleDrag(float applied);
+    void scaleLift(float applied);
     float clamp(float val, float min, float max);
     void addContactPoint(float* pos);
     void compileContactPoints();
@@ -166,6 +258,11 @@ private:
     float _approachFuel;
     float _approachGlideAngle;
 
+    enum { NTRIM = 5 }; // variables in solveNewton()
+    bool _newtonSolve;
+    Vector _solveClones;
+    bool _isSolveClone;
+    SolveWorkers* _solveWorkers; // during solve(), with clones
     int _solutionIterations;
     float _dragFactor;
     float _liftRatio;
@@ -0,0 +1,205 @@
+#include "Math.hpp"
+#include "StateHash.hpp"
+#include "ElectricMotor.hpp"
+namespace yasim {
+
+static const float PI2 = 6.28318530718f;
+
+// The largest root of a*x^2 + b*x + c, or zero if there's no positive
+// one.
+static float posRoot(float a, float b, float c)
+{
+    if(a <= 0)
+        return b > 0 && c < 0 ? -c/b : 0;
+    float disc = b*b - 4*a*c;
+    if(disc < 0) return 0;
+    float x = (-b + Math::sqrt(disc)) / (2*a);
+    return x > 0 ? x : 0;
+}
+
+ElectricMotor::ElectricMotor(float kv, float resistance, float maxCurrent,
+                             float voltage, float moment)
+{
+    _dir[0] = 1; _dir[1] = 0; _dir[2] = 0;
+    _kv = kv;
+    _resistance = resistance;
+    _maxCurrent = maxCurrent;
+    _idleCurrent = 0;
+    _voltage = voltage;
+    _escLag = 0;
+    _moment = moment;
+    _diameter = _pitch = _ct = _cq = 0;
+    _fuel = true;
+    init();
+}
+
+void ElectricMotor::setProp(float diameter, float pitch, float ct, float cq)
+{
+    _diameter = diameter;
+    _pitch = pitch;
+    _ct = ct;
+    _cq = cq;
+}
+
+bool ElectricMotor::isRunning()
+{
+    return _omega > 0;
+}
+
+bool ElectricMotor::isCranking()
+{
+    return false;
+}
+
+void ElectricMotor::getThrust(float* out)
+{
+    int i;
+    for(i=0; i<3; i++) out[i] = _thrust[i];
+}
+
+void ElectricMotor::getTorque(float* out)
+{
+    int i;
+    for(i=0; i<3; i++) out[i] = _torque[i];
+}
+
+void ElectricMotor::getGyro(float* out)
+{
+    int i;
+    for(i=0; i<3; i++) out[i] = _gyro[i];
+}
+
+float ElectricMotor::getFuelFlow()
+{
+    return 0;
+}
+
+// The propeller's thrust and torque are kt*omega*(omega - cv) and
+// kq*omega*(omega - cv), for the airspeed along the shaft now.
+void ElectricMotor::calcProp(float* kt, float* kq, float* cv)
+{
+    float d2 = _diameter * _diameter;
+    float k = _rho * d2 * d2 * (1/(PI2*PI2));
+    float speed = -Math::dot3(_wind, _dir);
+    *kt = _ct * k;
+    *kq = _cq * k * _diameter;
+    *cv = _pitch > 0 ? PI2 * speed / _pitch : 0;
+}
+
+// The motor's torque is a - b*omega near omega, for an ESC output:
+// linear in the back EMF, or constant at the current limit, or the
+// no-load loss alone when the back EMF is above the supply (the ESC
+// doesn't brake).
+void ElectricMotor::motorTorque(float duty, float omega, float* a, float* b)
+{
+    float volts = duty * _voltage;
+    float current = (volts - omega/_kv) / _resistance;
+    if(current > _maxCurrent) {
+        *a = (_maxCurrent - _idleCurrent) / _kv;
+        *b = 0;
+    } else if(current < 0) {
+        *a = -_idleCurrent / _kv;
+        *b = 0;
+    } else {
+        *a = (volts/_resistance - _idleCurrent) / _kv;
+        *b = 1 / (_kv * _kv * _resistance);
+    }
+}
+
+void ElectricMotor::setOutputs(float kt, float cv)
+{
+    float volts = _duty * _voltage;
+    _current = Math::clamp((volts - _omega/_kv) / _resistance,
+                           0, _maxCurrent);
+
+    // The reaction to the motor's torque, not the propeller's, is
+    // what the airframe feels (as for PropEngine).  A stopped motor
+    // has no friction to speak of.
+    float tau = (_current - _idleCurrent) / _kv;
+    if(_omega == 0 && tau < 0) tau = 0;
+    if(_moment > 0) tau = -tau;
+    Math::mul3(tau, _dir, _torque);
+    Math::mul3(kt * _omega * (_omega - cv), _dir, _thrust);
+    Math::mul3(_omega * _moment, _dir, _gyro);
+}
+
+void ElectricMotor::integrateAll(ElectricMotor** motors, int n, float dt)
+{
+    int i;
+    for(i=0; i<n; i++) {
+        ElectricMotor* m = motors[i];
+
+        // The ESC, integrated implicitly so that any lag works
+        float thr = Math::clamp(m->_throttle, 0, 1);
+        if(m->_escLag > 0) {
+            float k = dt / m->_escLag;
+            m->_duty = (m->_duty + k*thr) / (1 + k);
+        } else {
+            m->_duty = thr;
+        }
+
+        float kt, kq, cv, a, b;
+        m->calcProp(&kt, &kq, &cv);
+        m->motorTorque(m->_duty, m->_omega, &a, &b);
+
+        // J*domega/dt = a - b*omega - kq*omega*(omega - cv), with the
+        // damping terms taken at the new omega.
+        float w = m->_omega;
+        float h = dt / Math::abs(m->_moment);
+        w = (w + h*(a + kq*cv*w)) / (1 + h*(b + kq*w));
+        m->_omega = w > 0 ? w : 0;
+
+        m->setOutputs(kt, cv);
+    }
+}
+
+void ElectricMotor::integrate(float dt)
+{
+    ElectricMotor* m = this;
+    integrateAll(&m, 1, dt);
+}
+
+// Settles the ESC on the throttle and finds the omega at which the
+// motor's torque balances the propeller's: a quadratic in each of the
+// motor's regions.
+void ElectricMotor::stabilize()
+{
+    _duty = Math::clamp(_throttle, 0, 1);
+
+    float kt, kq, cv;
+    calcProp(&kt, &kq, &cv);
+    float volts = _duty * _voltage;
+    float a = (volts/_resistance - _idleCurrent) / _kv;
+    float b = 1 / (_kv * _kv * _resistance);
+    float w = posRoot(kq, b - kq*cv, -a);
+
+    float current = (volts - w/_kv) / _resistance;
+    if(current > _maxCurrent)
+        w = posRoot(kq, -kq*cv, -(_maxCurrent - _idleCurrent) / _kv);
+    else if(current < 0)
+        w = posRoot(kq, -kq*cv, _idleCurrent / _kv);
+    _omega = w;
+    setOutputs(kt, cv);
+}
+
+void ElectricMotor::init()
+{
+    _duty = 0;
+    _omega = 0;
+    _current = 0;
+    int i;
+    for(i=0; i<3; i++) _thrust[i] = _torque[i] = _gyro[i] = 0;
+}
+
+void ElectricMotor::hashState(StateHash* h)
+{
+    Thruster::hashState(h);
+    h->add(_duty);
+    h->add(_omega);
+    h->add(_current);
+    h->add(_thrust, 3);
+    h->add(_torque, 3);
+    h->add(_gyro, 3);
+}
+
+}; // namespace yasim
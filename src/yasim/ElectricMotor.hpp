@@ -0,0 +1,87 @@
+#ifndef _ELECTRICMOTOR_HPP
+#define _ELECTRICMOTOR_HPP
+
+#include "Thruster.hpp"
+
+namespace yasim {
+
+// A brushless motor on an ESC, turning a fixed-pitch propeller, as on
+// a multirotor.  The ESC's output follows the throttle with a first
+// order lag, and is applied to the motor as a fraction of the battery
+// voltage.  The motor is the usual DC model: the current is the
+// voltage less the back EMF (omega/Kv) over the winding resistance, up
+// to the current limit, and the torque is the current less the no-load
+// current, times 1/Kv.  The propeller's thrust and torque coefficients
+// fall linearly with the advance ratio, to zero at pitch/diameter, so
+// both go as omega*(omega - c*v) with constants worked out once.
+//
+// Units are SI: Kv in rad/s per volt, lengths in meters.  The moment
+// of inertia is that of everything that spins; a negative one turns
+// the other way, as for PropEngine.
+class ElectricMotor : public Thruster {
+public:
+    ElectricMotor(float kv, float resistance, float maxCurrent,
+                  float voltage, float moment);
+
+    void setIdleCurrent(float current) { _idleCurrent = current; }
+    void setEscLag(float lag) { _escLag = lag; }
+    void setProp(float diameter, float pitch, float ct, float cq);
+
+    virtual ElectricMotor* getElectricMotor() { return this; }
+
+    // Dynamic output
+    virtual bool isRunning();
+    virtual bool isCranking();
+    virtual void getThrust(float* out);
+    virtual void getTorque(float* out);
+    virtual void getGyro(float* out);
+    virtual float getFuelFlow();
+
+    // Runtime instructions
+    virtual void init();
+    virtual void integrate(float dt);
+    virtual void stabilize();
+    virtual void hashState(StateHash* h);
+
+    // Stable at any step, but fast enough to see the ESC lag.
+    virtual float getUpdateRate() { return 500; }
+
+    // Integrates n motors over one step, with no virtual calls and no
+    // transcendentals: the rotor speed is updated semi-implicitly, so
+    // it is stable at any step.  The wind and air must be set.
+    static void integrateAll(ElectricMotor** motors, int n, float dt);
+
+    float getOmega() { return _omega; }
+    void setOmega(float omega) { _omega = omega; }
+    float getCurrent() { return _current; } // amps
+
+private:
+    void calcProp(float* kt, float* kq, float* cv);
+    void motorTorque(float duty, float omega, float* a, float* b);
+    void setOutputs(float kt, float cv);
+
+    // Motor
+    float _kv;
+    float _resistance;
+    float _maxCurrent;
+    float _idleCurrent;
+    float _voltage;
+    float _escLag;  // seconds
+    float _moment;
+
+    // Propeller
+    float _diameter;
+    float _pitch;
+    float _ct;
+    float _cq;
+
+    float _duty;    // ESC output, 0-1
+    float _omega;
+    float _current;
+    float _thrust[3];
+    float _torque[3];
+    float _gyro[3];
+};
+
+}; // namespace yasim
+#endif // _ELECTRICMOTOR_HPP
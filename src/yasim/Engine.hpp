@@ -1,6 +1,8 @@
 #ifndef _ENGINE_HPP
 #define _ENGINE_HPP
 
+#include "StateHash.hpp"
+
 namespace yasim {
 
 class PistonEngine;
@@ -18,6 +20,9 @@ public:
     virtual PistonEngine* isPistonEngine() { return 0; }
     virtual TurbineEngine* isTurbineEngine() { return 0; }
 
+    // A new engine of the same kind, in the same state.
+    virtual Engine* clone() = 0;
+
     void setThrottle(float throttle) { _throttle = throttle; }
     void setStarter(bool starter) { _starter = starter; }
     void setMagnetos(int magnetos) { _magnetos = magnetos; }
@@ -35,6 +40,19 @@ public:
     virtual float getTorque() = 0;
     virtual float getFuelFlow() = 0;
 
+    // Adds the runtime state to a digest, for the deterministic mode.
+    virtual void hashState(StateHash* h) {
+        h->add(_throttle); h->add(_starter); h->add(_magnetos);
+        h->add(_mixture); h->add(_boost); h->add(_fuel); h->add(_running);
+    }
+
+    // Adds every input that, with the air and the speed, decides
+    // where stabilize() settles, for PropEngine to remember it by.
+    virtual void hashControls(StateHash* h) {
+        h->add(_throttle); h->add(_starter); h->add(_magnetos);
+        h->add(_mixture); h->add(_boost); h->add(_fuel); h->add(_running);
+    }
+
     virtual ~Engine() {}
 protected:
     float _throttle;
@@ -4,6 +4,7 @@
 
 #include <cstdio>
 #include <cstring>
+#include <cfenv>
 
 #include "fg_props.hxx"
 
@@ -15,12 +16,15 @@
 #include "Launchbar.hpp"
 #include "Atmosphere.hpp"
 #include "PropEngine.hpp"
+#include "ElectricMotor.hpp"
 #include "Propeller.hpp"
 #include "PistonEngine.hpp"
 #include "TurbineEngine.hpp"
 #include "Rotor.hpp"
 #include "Rotorpart.hpp"
 #include "Hitch.hpp"
+#include "StateHash.hpp"
+#include "AeroDatabase.hpp"
 
 #include "FGFDM.hpp"
 
@@ -29,6 +33,7 @@ namespace yasim {
 // Some conversion factors
 static const float KTS2MPS = 0.514444444444;
 static const float FT2M = 0.3048;
+static const float IN2M = 0.0254;
 static const float DEG2RAD = 0.0174532925199;
 static const float RPM2RAD = 0.10471975512;
 static const float LBS2N = 4.44822;
@@ -42,6 +47,10 @@ static const float K2DEGFOFFSET = -459.4;
 static const float CIN2CM = 1.6387064e-5;
 static const float YASIM_PI = 3.14159265358979323846;
 
+// Turbulence is generated from a fixed seed, so runs are repeatable.
+// The deterministic mode depends on this.
+static const int TURBULENCE_SEED = 0;
+
 static const float NM2FTLB = (1/(LBS2N*FT2M));
 
 // Stubs, so that this can be compiled without the FlightGear
@@ -61,9 +70,12 @@ FGFDM::FGFDM()
     // who trim their approaches using things other than elevator.
     _airplane.setElevatorControl(parseAxis("/controls/flight/elevator-trim"));
 
-    // FIXME: read seed from somewhere?
-    int seed = 0;
-    _turb = new Turbulence(10, seed);
+    _turb = new Turbulence(10, TURBULENCE_SEED);
+
+    _deterministic = false;
+    _step = 0;
+
+    _aeroDb = 0;
 }
 
 FGFDM::~FGFDM()
@@ -91,10 +103,16 @@ FGFDM::~FGFDM()
         delete (PropOut*)_controlProps.get(i);
 
     delete _turb;
+    delete _aeroDb;
 }
 
 void FGFDM::iterate(float dt)
 {
+    // Something else in the process may have changed the rounding or
+    // denormal modes since the last step.
+    if(_deterministic)
+        fesetenv(FE_DFL_ENV);
+
     getExternalInput(dt);
     _airplane.iterate(dt);
 
@@ -115,6 +133,15 @@ void FGFDM::iterate(float dt)
     _airplane.calcFuelWeights();
     
     setOutputProperties(dt);
+
+    if(_deterministic) {
+        StateHash h;
+        _airplane.getModel()->hashState(&h);
+        char buf[64];
+        sprintf(buf, "%016llx", (unsigned long long)h.get());
+        SG_LOG(SG_FLIGHT, SG_ALERT, "YASim step " << _step << " state " << buf);
+        _step++;
+    }
 }
 
 Airplane* FGFDM::getAirplane()
@@ -124,6 +151,79 @@ Airplane* FGFDM::getAirplane()
 
 void FGFDM::init()
 {
+    // Deterministic mode: default floating point environment, and a
+    // digest of the complete state logged after every step.  Two runs
+    // with the same inputs must produce the same log; the first line
+    // that differs is the step where they diverged.
+    _deterministic = fgGetBool("/fdm/yasim/deterministic", false);
+    _step = 0;
+    if(_deterministic) {
+        fesetenv(FE_DFL_ENV);
+        SG_LOG(SG_FLIGHT, SG_ALERT, "YASim deterministic mode, turbulence seed "
+               << TURBULENCE_SEED);
+    }
+
+    // Optional table lookup of the surfaces' stall and flap lift
+    // functions, by resolution (see yasim-test -T for the error).
+    int tables = fgGetInt("/fdm/yasim/surface-tables", 0);
+    if(tables > 0) {
+        float err = _airplane.getModel()->setSurfaceTables(tables);
+        SG_LOG(SG_FLIGHT, SG_INFO, "YASim surface tables, resolution "
+               << tables << ", max error " << err);
+    }
+
+    // Likewise the propellers' thrust and torque curves (see proptest
+    // for the error).
+    int propTables = fgGetInt("/fdm/yasim/propeller-tables", 0);
+    if(propTables > 0) {
+        float err = 0;
+        for(int i=0; i<_airplane.numThrusters(); i++) {
+            Propeller* p = _airplane.getThruster(i)->getPropeller();
+            float e = p ? p->setTable(propTables) : 0;
+            if(e > err) err = e;
+        }
+        SG_LOG(SG_FLIGHT, SG_INFO, "YASim propeller tables, resolution "
+               << propTables << ", max error " << err);
+    }
+
+    // And the piston engines' supercharger and manifold temperature
+    // functions.
+    if(fgGetBool("/fdm/yasim/piston-tables", false)) {
+        for(int i=0; i<_airplane.numThrusters(); i++) {
+            Engine* e = _airplane.getThruster(i)->getEngine();
+            if(e && e->isPistonEngine())
+                e->isPistonEngine()->setTables(true);
+        }
+        SG_LOG(SG_FLIGHT, SG_INFO, "YASim piston engine tables, max error "
+               << PistonEngine::getTableError());
+    }
+
+    // Engine dynamics at each type's own rate, rather than every
+    // step: 1 holds the thrust and torque in between, 2 extrapolates
+    // them.
+    int decimation = fgGetInt("/fdm/yasim/engine-decimation", 0);
+    if(decimation > ThrusterBank::DECIMATE_OFF
+       && decimation <= ThrusterBank::DECIMATE_EXTRAPOLATE) {
+        _airplane.getModel()->setThrusterDecimation(decimation);
+        SG_LOG(SG_FLIGHT, SG_INFO, "YASim engine decimation " << decimation);
+    }
+
+    // The rotorparts of a helicopter's rotors spread over this many
+    // threads, each part seeing the flapping angles of the last
+    // evaluation; zero evaluates them in turn, as always.
+    int rotorThreads = fgGetInt("/fdm/yasim/rotor-threads", 0);
+    if(rotorThreads > 0 && _airplane.getModel()->getRotorgear()->isInUse()) {
+        _airplane.getModel()->setRotorThreads(rotorThreads);
+        SG_LOG(SG_FLIGHT, SG_INFO, "YASim rotor threads " << rotorThreads);
+    }
+
+    // Optional whole-aircraft aerodynamic table, as written by
+    // "yasim <ac.xml> -d <file>", in place of the surfaces.
+    const char* dbfile = fgGetNode("/fdm/yasim/aero-database", true)
+        ->getStringValue();
+    if(dbfile && dbfile[0])
+        loadAeroDatabase(dbfile);
+
     _turb_magnitude_norm = fgGetNode("/environment/turbulence/magnitude-norm", true);
     _turb_rate_hz        = fgGetNode("/environment/turbulence/rate-hz", true);
     _gross_weight_lbs    = fgGetNode("/yasim/gross-weight-lbs", true);
@@ -170,6 +270,12 @@ void FGFDM::init()
             tp._epr =      node->getChild("epr",      0, true);
             tp._egt_degf = node->getChild("egt-degf", 0, true);
         }
+
+        if(t->getElectricMotor())
+        {
+            tp._rpm = node->getChild("rpm", 0, true);
+            tp._current_amps = node->getChild("current-amps", 0, true);
+        }
         _thrust_props.push_back(tp);
     }
 
@@ -270,6 +376,8 @@ void FGFDM::startElement(const char* name, const XMLAttributes &atts)
         parseTurbineEngine(a);
     } else if(eq(name, "propeller")) {
 	parsePropeller(a);
+    } else if(eq(name, "motor")) {
+        parseMotor(a);
     } else if(eq(name, "thruster")) {
 	SimpleJet* j = new SimpleJet();
 	_currObj = j;
@@ -554,6 +662,7 @@ void FGFDM::getExternalInput(float dt)
         AxisRec* a = (AxisRec*)_axes.get(i);
         float val = fgGetFloat(a->name, 0);
         cm->setInput(a->handle, val);
+        if(_aeroDb) _aeroDb->setInput(a->handle, val);
     }
     cm->applyControls(dt);
 
@@ -571,6 +680,9 @@ void FGFDM::getExternalInput(float dt)
             PropEngine* p = t->getPropEngine();
             sprintf(buf, "%s/rpm", er->prefix);
             p->setOmega(fgGetFloat(buf, 500) * RPM2RAD);
+        } else if(t->getElectricMotor()) {
+            sprintf(buf, "%s/rpm", er->prefix);
+            t->getElectricMotor()->setOmega(fgGetFloat(buf, 0) * RPM2RAD);
         }
     }
 }
@@ -688,6 +800,12 @@ void FGFDM::setOutputProperties(float dt)
             moveprop(node, "oilt-norm", pnorm, dt/30); // 30s 
             moveprop(node, "itt-norm", pnorm, dt/1); // 1s
         }
+
+        if(t->getElectricMotor()) {
+            ElectricMotor* m = t->getElectricMotor();
+            tp._rpm->setFloatValue(m->getOmega() * (1/RPM2RAD));
+            tp._current_amps->setFloatValue(m->getCurrent());
+        }
     }
 }
 
@@ -974,6 +1092,52 @@ void FGFDM::parsePropeller(XMLAttributes* a)
     _currObj = thruster;
 }
 
+// An electric motor and its propeller.  Each motor takes its throttle
+// from its own engine's controls, with no control-input needed, so
+// the flight controller can command the motors one by one.
+void FGFDM::parseMotor(XMLAttributes* a)
+{
+    float v[3];
+    v[0] = attrf(a, "x");
+    v[1] = attrf(a, "y");
+    v[2] = attrf(a, "z");
+    float mass = attrf(a, "mass") * LBS2KG;
+    float kv = attrf(a, "kv") * RPM2RAD;
+    float resistance = attrf(a, "resistance");
+    float current = attrf(a, "max-current");
+    float voltage = attrf(a, "voltage");
+    float moment = attrf(a, "moment");
+
+    ElectricMotor* m = new ElectricMotor(kv, resistance, current,
+                                         voltage, moment);
+    m->setPosition(v);
+    _airplane.addThruster(m, mass, v);
+
+    // Straight up, unless told otherwise
+    v[0] = attrf(a, "vx", 0);
+    v[1] = attrf(a, "vy", 0);
+    v[2] = attrf(a, "vz", 1);
+    m->setDirection(v);
+
+    m->setIdleCurrent(attrf(a, "idle-current", 0));
+    m->setEscLag(attrf(a, "esc-lag", 0.02f));
+    m->setProp(attrf(a, "diameter") * IN2M, attrf(a, "pitch") * IN2M,
+               attrf(a, "ct", 0.1f), attrf(a, "cq", 0.008f));
+
+    char buf[64];
+    sprintf(buf, "/controls/engines/engine[%d]/throttle", _nextEngine);
+    _airplane.getControlMap()->addMapping(parseAxis(buf),
+                                          ControlMap::THROTTLE, m);
+
+    sprintf(buf, "/engines/engine[%d]", _nextEngine++);
+    EngRec* er = new EngRec();
+    er->eng = m;
+    er->prefix = dup(buf);
+    _thrusters.add(er);
+
+    _currObj = m;
+}
+
 // Turns a string axis name into an integer for use by the
 // ControlMap.  Creates a new axis if this one hasn't been defined
 // yet.
@@ -994,6 +1158,45 @@ int FGFDM::parseAxis(const char* name)
     return a->handle;
 }
 
+void FGFDM::loadAeroDatabase(const char* file)
+{
+    FILE* in = fopen(file, "rb");
+    AeroDatabase* db = new AeroDatabase();
+    if(!in || !db->read(in)) {
+        SG_LOG(SG_FLIGHT, SG_ALERT, "YASim can't read aero database "
+               << file << ", using the surfaces");
+        if(in) fclose(in);
+        delete db;
+        return;
+    }
+    fclose(in);
+
+    // Feed each tabulated control from the input axis of the same name.
+    for(int i=0; i<db->numControls(); i++) {
+        int handle = getAxisHandle(db->getControlName(i));
+        if(handle < 0)
+            SG_LOG(SG_FLIGHT, SG_ALERT, "YASim aero database control "
+                   << db->getControlName(i) << " has no input axis");
+        db->setControlInput(i, handle);
+    }
+
+    delete _aeroDb;
+    _aeroDb = db;
+    _airplane.getModel()->setAeroDatabase(_aeroDb);
+    SG_LOG(SG_FLIGHT, SG_INFO, "YASim aero database " << file << ", "
+           << db->numControls() << " controls");
+}
+
+int FGFDM::getAxisHandle(const char* name)
+{
+    for(int i=0; i<_axes.size(); i++) {
+        AxisRec* a = (AxisRec*)_axes.get(i);
+        if(eq(a->name, name))
+            return a->handle;
+    }
+    return -1;
+}
+
 int FGFDM::parseOutput(const char* name)
 {
     if(eq(name, "THROTTLE"))  return ControlMap::THROTTLE;
@@ -10,6 +10,7 @@
 namespace yasim {
 
 class Wing;
+class AeroDatabase;
 
 // This class forms the "glue" to the FlightGear codebase.  It handles
 // parsing of XML airplane files, interfacing to the properties
@@ -24,6 +25,10 @@ public:
 
     Airplane* getAirplane();
 
+    // Returns the ControlMap input handle for the named axis
+    // property, or -1 if the airplane doesn't use it.
+    int getAxisHandle(const char* name);
+
     // XML parsing callback from XMLVisitor
     virtual void startElement(const char* name, const XMLAttributes &atts);
 
@@ -37,6 +42,7 @@ private:
                      float min, max; };
 
     void setOutputProperties(float dt);
+    void loadAeroDatabase(const char* file);
 
     Rotor* parseRotor(XMLAttributes* a, const char* name);
     Wing* parseWing(XMLAttributes* a, const char* name);
@@ -46,6 +52,7 @@ private:
     void parseTurbineEngine(XMLAttributes* a);
     void parsePistonEngine(XMLAttributes* a);
     void parsePropeller(XMLAttributes* a);
+    void parseMotor(XMLAttributes* a);
     bool eq(const char* a, const char* b);
     bool caseeq(const char* a, const char* b);
     char* dup(const char* s);
@@ -79,6 +86,13 @@ private:
     // Radius of the vehicle, for intersection testing.
     float _vehicle_radius;
 
+    // Optional table-driven aerodynamics, or null
+    AeroDatabase* _aeroDb;
+
+    // Deterministic mode, and the number of steps run in it
+    bool _deterministic;
+    unsigned int _step;
+
     // Parsing temporaries
     void* _currObj;
     bool _cruiseCurr;
@@ -99,6 +113,7 @@ private:
         SGPropertyNode_ptr _rpm, _torque_ftlb, _mp_osi, _mp_inhg;
         SGPropertyNode_ptr _oil_temperature_degf, _boost_gauge_inhg;
         SGPropertyNode_ptr _n1, _n2, _epr, _egt_degf;
+        SGPropertyNode_ptr _current_amps;
     };
 
     SGPropertyNode_ptr _turb_magnitude_norm, _turb_rate_hz;
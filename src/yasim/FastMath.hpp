@@ -0,0 +1,247 @@
+#ifndef _FASTMATH_HPP
+#define _FASTMATH_HPP
+
+#include <math.h>
+#include <string.h>
+
+namespace yasim {
+
+//
+// Polynomial approximations to the transcendental functions, in two
+// accuracy tiers: PRECISE (relative error about 1e-6) and FAST (about
+// 1e-4).  The coefficients are minimax fits of the relative error over
+// the reduced ranges.  Arguments outside the range the reductions
+// handle well (huge angles, negative or denormal pow() bases,
+// overflowing exponents, NaNs) go to the C library; asin() and acos()
+// take only [-1:1].  "yasim -m" measures each tier against libm.
+//
+// Use these through the Math::f*() wrappers, which select the tier.
+//
+class FastMath
+{
+public:
+    enum { EXACT, PRECISE, FAST };
+
+    // Both polynomials are evaluated and the quadrant selects one,
+    // so there is no unpredictable branch.
+    template<int T> static inline float sin(float x) {
+        int q; float r;
+        if(!reduce(x, &q, &r)) return (float)::sin(x);
+        float s = sinPoly<T>(r), c = cosPoly<T>(r);
+        return flip((q & 1) ? c : s, q & 2);
+    }
+
+    template<int T> static inline float cos(float x) {
+        int q; float r;
+        if(!reduce(x, &q, &r)) return (float)::cos(x);
+        float s = sinPoly<T>(r), c = cosPoly<T>(r);
+        return flip((q & 1) ? s : c, (q+1) & 2);
+    }
+
+    template<int T> static inline float atan(float x) {
+        // Reduce to [0:tan(pi/8)] with atan(x) = pi/2 - atan(1/x) and
+        // atan(x) = pi/4 + atan((x-1)/(x+1)).
+        float a = x < 0 ? -x : x;
+        float y = 0;
+        if(a > 2.414213562f) {
+            y = 1.570796327f;
+            a = -1/a;
+        } else if(a > 0.414213562f) {
+            y = 0.785398163f;
+            a = (a-1)/(a+1);
+        }
+        y += atanPoly<T>(a);
+        return x < 0 ? -y : y;
+    }
+
+    template<int T> static inline float atan2(float y, float x) {
+        if(x == 0 || x != x || y != y) return (float)::atan2(y, x);
+        float a = atan<T>(y/x);
+        if(x > 0) return a;
+        return y < 0 ? a - 3.141592654f : a + 3.141592654f;
+    }
+
+    template<int T> static inline float pow(float b, float e) {
+        // b^e = 2^(e*log2(b)), for normal positive b only.  The
+        // product is taken in double so that its rounding doesn't
+        // spoil large results.
+        unsigned int bits;
+        memcpy(&bits, &b, 4);
+        if(bits - 0x00800000u >= 0x7f000000u)
+            return (float)::pow((double)b, (double)e);
+        return exp2<T>((double)e * log2<T>(bits));
+    }
+
+    template<int T> static inline float exp(float x) {
+        return exp2<T>((double)x * 1.4426950408889634);
+    }
+
+    // For x in [-1:1].  Above 1/2, asin(x) = pi/2 - 2*asin(s) with
+    // s = sqrt((1-x)/2), so the polynomial only sees [0:1/2].  Both
+    // halves are evaluated and |x| selects one.
+    template<int T> static inline float asin(float x) {
+        if(T == EXACT) return (float)::asin(x);
+        float a = x < 0 ? -x : x;
+        bool big = a > 0.5f;
+        float p = asinHalf<T>(a, big);
+        float y = big ? 1.570796327f - 2*p : p;
+        return x < 0 ? -y : y;
+    }
+
+    // For x in [-1:1]: 2*asin(s) above 1/2, which keeps the relative
+    // error small near zero, pi less that below -1/2, and pi/2 -
+    // asin(x) in between.
+    template<int T> static inline float acos(float x) {
+        if(T == EXACT) return (float)::acos(x);
+        float a = x < 0 ? -x : x;
+        bool big = a > 0.5f;
+        float p = asinHalf<T>(a, big);
+        float y = x < 0 ? 3.141592654f - 2*p : 2*p;
+        return big ? y : 1.570796327f - (x < 0 ? -p : p);
+    }
+
+    // Variants of sin(), cos() and exp() without the library calls
+    // for awkward arguments, so that a loop of them can be vectorized.
+    // The caller keeps |x| below 1e5 for sin and cos, and x in
+    // [-87:88] for exp.  These and asin() and acos() take EXACT too,
+    // as the C library, so that a loop written for the approximations
+    // can be built for any tier.
+    template<int T> static inline void sinCosNear(float x, float* s,
+                                                  float* c) {
+        if(T == EXACT) {
+            *s = (float)::sin(x);
+            *c = (float)::cos(x);
+            return;
+        }
+        int k = roundi((double)x * 0.63661977236758134);
+        float r = (float)((double)x - k * 1.5707963267948966);
+        float sp = sinPoly<T>(r), cp = cosPoly<T>(r);
+        *s = flip((k & 1) ? cp : sp, k & 2);
+        *c = flip((k & 1) ? sp : cp, (k+1) & 2);
+    }
+
+    template<int T> static inline float sinNear(float x) {
+        if(T == EXACT) return (float)::sin(x);
+        float s, c;
+        sinCosNear<T>(x, &s, &c);
+        return s;
+    }
+
+    template<int T> static inline float expNear(float x) {
+        if(T == EXACT) return (float)::exp(x);
+        return exp2Near<T>((double)x * 1.4426950408889634);
+    }
+
+private:
+    // Rounds to the nearest integer, for |d| < 2^31, by adding
+    // 1.5*2^52 so the integer lands in the low mantissa bits.
+    static inline int roundi(double d) {
+        d += 6755399441055744.0;
+        long long i;
+        memcpy(&i, &d, 8);
+        return (int)i;
+    }
+
+    // Negates f if neg is non-zero, by flipping the sign bit.
+    static inline float flip(float f, int neg) {
+        unsigned int bits;
+        memcpy(&bits, &f, 4);
+        bits ^= neg ? 0x80000000u : 0;
+        memcpy(&f, &bits, 4);
+        return f;
+    }
+
+    // x = q*pi/2 + r, r in [-pi/4:pi/4], q mod 4.  The reduction is
+    // done in double, which is exact enough for |x| < 1e5.
+    static inline bool reduce(float x, int* q, float* r) {
+        if(!(x > -1e5f && x < 1e5f)) return false;
+        int k = roundi((double)x * 0.63661977236758134);
+        *r = (float)((double)x - k * 1.5707963267948966);
+        *q = k & 3;
+        return true;
+    }
+
+    template<int T> static inline float sinPoly(float r) {
+        float r2 = r*r;
+        if(T == FAST)
+            return r + r*r2*(-0.166633904f + r2*0.00816328149f);
+        return r + r*r2*(-0.166666546f + r2*(0.00833216076f
+                                             + r2*-0.000195152826f));
+    }
+
+    template<int T> static inline float cosPoly(float r) {
+        float r2 = r*r;
+        if(T == FAST)
+            return 1 + r2*(-0.499760556f + r2*0.0404584492f);
+        return 1 + r2*(-0.499998847f + r2*(0.041655777f
+                                           + r2*-0.0013591853f));
+    }
+
+    template<int T> static inline float atanPoly(float a) {
+        float a2 = a*a;
+        if(T == FAST)
+            return a + a*a2*(-0.331833767f + a2*0.170341706f);
+        return a + a*a2*(-0.333329491f + a2*(0.199777099f
+                         + a2*(-0.138776777f + a2*0.0805371913f)));
+    }
+
+    // asin(a) for a in [0:1/2], or asin(sqrt((1-a)/2)) if big, as
+    // s + s*z*P(z) with z = s^2.
+    template<int T> static inline float asinHalf(float a, bool big) {
+        float z = big ? 0.5f*(1-a) : a*a;
+        float s = big ? ::sqrtf(z) : a;
+        float p;
+        if(T == FAST)
+            p = 0.165059105f + z*0.0942901671f;
+        else
+            p = 0.166655809f + z*(0.0754052028f + z*(0.0400358886f
+                                                     + z*0.0499509797f));
+        return s + s*z*p;
+    }
+
+    // log2 of a normal positive float, given its bits: the exponent,
+    // plus log2 of the mantissa scaled into [sqrt(1/2):sqrt(2)] as a
+    // series in s = (m-1)/(m+1).  Offsetting the bits by those of
+    // sqrt(1/2) splits them there without a branch.
+    template<int T> static inline double log2(unsigned int bits) {
+        unsigned int off = bits - 0x3f3504f3u;
+        int e = (int)off >> 23;
+        unsigned int mbits = (off & 0x007fffffu) + 0x3f3504f3u;
+        float m;
+        memcpy(&m, &mbits, 4);
+        float s = (m-1)/(m+1);
+        float s2 = s*s;
+        float l;
+        if(T == FAST)
+            l = s*(2.88532593f + s2*0.979125369f);
+        else
+            l = s*(2.88539042f + s2*(0.961588374f + s2*0.595779428f));
+        return e + (double)l;
+    }
+
+    // 2^t: the integer part goes into the exponent bits, the rest
+    // (in [-1/2:1/2]) through a polynomial.
+    template<int T> static inline float exp2(double t) {
+        if(!(t > -126 && t < 127))
+            return (float)::pow(2.0, t);
+        return exp2Near<T>(t);
+    }
+
+    template<int T> static inline float exp2Near(double t) {
+        int k = roundi(t);
+        float f = (float)(t - k);
+        float p;
+        if(T == FAST)
+            p = 1 + f*(0.693282929f + f*(0.242210972f + f*0.0550089297f));
+        else
+            p = 1 + f*(0.693146978f + f*(0.240222421f + f*(0.0555073375f
+                    + f*(0.00967151286f + f*0.00132647271f))));
+        unsigned int sbits = (unsigned int)(k + 127) << 23;
+        float scale;
+        memcpy(&scale, &sbits, 4);
+        return p * scale;
+    }
+};
+
+}; // namespace yasim
+#endif // _FASTMATH_HPP
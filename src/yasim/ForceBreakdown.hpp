@@ -0,0 +1,66 @@
+#ifndef _FORCEBREAKDOWN_HPP
+#define _FORCEBREAKDOWN_HPP
+
+#include <cstdio>
+
+namespace yasim {
+
+//
+// The force and moment of each part of the aircraft, as recorded by
+// Model::calcForces() for the first Runge-Kutta stage of a step (the
+// state at the start of the step).  Only filled in when built with
+// YASIM_FORCE_BREAKDOWN; see Model::getForceBreakdown().
+//
+// Forces are in newtons and moments in N*m about the c.g., both in
+// local coordinates.  Vstabs and thrusters past the fixed maximum are
+// added to the last slot.
+//
+struct ForceBreakdown {
+    enum { MAX_VSTABS = 8, MAX_THRUSTERS = 8 };
+    enum { WING, TAIL,
+           VSTAB,
+           FUSELAGE = VSTAB + MAX_VSTABS,
+           GEAR_DRAG,     // the drag surfaces of the gear
+           WEIGHT_DRAG,   // the drag surfaces of settable weights
+           AERO_TABLE,    // an AeroDatabase in place of the surfaces
+           THRUSTER,
+           GEAR = THRUSTER + MAX_THRUSTERS, // ground contact
+           HOOK, LAUNCHBAR, HITCH, ROTOR, GROUND_EFFECT,
+           NCATEGORIES };
+
+    float force[NCATEGORIES][3];
+    float moment[NCATEGORIES][3];
+
+    void clear() {
+        for(int i=0; i<NCATEGORIES; i++)
+            for(int j=0; j<3; j++)
+                force[i][j] = moment[i][j] = 0;
+    }
+
+    static int vstab(int i) {
+        return VSTAB + (i < MAX_VSTABS ? i : MAX_VSTABS-1);
+    }
+    static int thruster(int i) {
+        return THRUSTER + (i < MAX_THRUSTERS ? i : MAX_THRUSTERS-1);
+    }
+
+    // A printable name for a category.
+    static void getName(int c, char* buf, int len) {
+        static const char* names[] = { "wing", "tail", "fuselage",
+            "gear-drag", "weight-drag", "aero-table", "gear", "hook",
+            "launchbar", "hitch", "rotor", "ground-effect" };
+        if(c >= VSTAB && c < FUSELAGE)
+            snprintf(buf, len, "vstab[%d]", c - VSTAB);
+        else if(c >= THRUSTER && c < GEAR)
+            snprintf(buf, len, "thruster[%d]", c - THRUSTER);
+        else if(c < VSTAB)
+            snprintf(buf, len, "%s", names[c]);
+        else if(c < THRUSTER)
+            snprintf(buf, len, "%s", names[c - FUSELAGE + 2]);
+        else
+            snprintf(buf, len, "%s", names[c - GEAR + 6]);
+    }
+};
+
+}; // namespace yasim
+#endif // _FORCEBREAKDOWN_HPP
@@ -276,8 +276,8 @@ float Gear::getBumpAltitude()
     //height. This is not very fast, but for a beginning.
     //maybe this should be done by interpolating between some precalculated
     //values
-    float h = Math::sin(x)+Math::sin(7*x)+Math::sin(8*x)+Math::sin(13*x);
-    h += Math::sin(2*y)+Math::sin(5*y)+Math::sin(9*y*x)+Math::sin(17*y);
+    float h = Math::fsin(x)+Math::fsin(7*x)+Math::fsin(8*x)+Math::fsin(13*x);
+    h += Math::fsin(2*y)+Math::fsin(5*y)+Math::fsin(9*y*x)+Math::fsin(17*y);
     
     return h*(1/8.)*_ground_bumpiness*maxGroundBumpAmplitude;
 }
@@ -417,8 +417,8 @@ void Gear::calcForce(RigidBody* body, State *s, float* v, float* rot)
 
     if(_rot != 0) {
 	// Correct for a rotation
-        float srot = Math::sin(_rot);
-        float crot = Math::cos(_rot);
+        float srot = Math::fsin(_rot);
+        float crot = Math::fcos(_rot);
         float tx = steer[0];
         float ty = steer[1];
         steer[0] =  crot*tx + srot*ty;
@@ -440,7 +440,7 @@ void Gear::calcForce(RigidBody* body, State *s, float* v, float* rot)
         // or else the angle will animate the "jitter" of a stopped
         // gear.
         if(_rollSpeed > 0.05)
-            _casterAngle = Math::atan2(vskid, vsteer);
+            _casterAngle = Math::fatan2(vskid, vsteer);
         return;
     } else {
         _rollSpeed = vsteer;
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Airplane.hpp"
+#include "Model.hpp"
+#include "Surface.hpp"
+#include "Wing.hpp"
+#include "GeneratedAircraft.hpp"
+namespace yasim {
+
+// Prints a float as a literal that reads back to exactly the same
+// value.  Returns false for infinities and NaNs, which have none.
+static bool putFloat(FILE* out, float f)
+{
+    if(f != f || f - f != 0)
+        return false;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.9g", f);
+    if(!strpbrk(buf, ".e"))
+        strcat(buf, ".0");
+    fprintf(out, "%sf", buf);
+    return true;
+}
+
+static bool putFloats(FILE* out, const float* f, int n)
+{
+    bool ok = true;
+    fprintf(out, "{ ");
+    for(int i=0; i<n; i++) {
+        if(i) fprintf(out, ", ");
+        ok &= putFloat(out, f[i]);
+    }
+    fprintf(out, " }");
+    return ok;
+}
+
+// Only Wings move controls (see ControlMap), so a surface using its
+// own control array, or a Wing's constant zero, has no live controls
+// of that kind.
+int GeneratedAircraft::liveControls(Surface* s)
+{
+    int live = 0;
+    if(s->_controls == s->_ownControls) return 0;
+    if(s->_flapIdx != Wing::ZERO) live |= 1<<FLAP;
+    if(s->_slatIdx != Wing::ZERO) live |= 1<<SLAT;
+    if(s->_spoilerIdx != Wing::ZERO) live |= 1<<SPOILER;
+    return live;
+}
+
+bool GeneratedAircraft::write(Airplane* a, const char* name,
+                              const char* source, FILE* out)
+{
+    Model* m = a->getModel();
+    bool ok = true;
+    int i, ngen = 0;
+
+    fprintf(out, "// Generated by yasim-gen from %s.  Do not edit.\n\n",
+            source);
+    fprintf(out, "#include \"GeneratedAircraft.hpp\"\n");
+    fprintf(out, "namespace yasim {\n\n");
+
+    // Surfaces.  Those with no coefficients produce no force and are
+    // left out.  An empty array isn't legal, so there is always at
+    // least a placeholder.
+    fprintf(out, "static constexpr GeneratedAircraft::SurfaceRec SURFACES[] = {\n");
+    for(i=0; i<m->numSurfaces(); i++) {
+        Surface* s = m->getSurface(i);
+        if(s->_cx == 0 && s->_cy == 0 && s->_cz == 0)
+            continue;
+        float f[6];
+        fprintf(out, "    { %d, %d,\n      ", i, liveControls(s));
+        ok &= putFloats(out, s->_pos, 3);
+        fprintf(out, ",\n      ");
+        ok &= putFloats(out, s->_orient, 9);
+        fprintf(out, ",\n      ");
+        f[0] = s->_c0; f[1] = s->_cx; f[2] = s->_cy; f[3] = s->_cz;
+        f[4] = s->_cz0; f[5] = s->_chord;
+        for(int j=0; j<6; j++) {
+            ok &= putFloat(out, f[j]);
+            fprintf(out, ", ");
+        }
+        fprintf(out, "\n      ");
+        ok &= putFloats(out, s->_peaks, 2);
+        fprintf(out, ", ");
+        ok &= putFloats(out, s->_stalls, 4);
+        fprintf(out, ", ");
+        ok &= putFloats(out, s->_widths, 4);
+        fprintf(out, ",\n      ");
+        f[0] = s->_slatAlpha; f[1] = s->_slatDrag;
+        f[2] = s->_flapLift; f[3] = s->_flapDrag;
+        f[4] = s->_spoilerLift; f[5] = s->_spoilerDrag;
+        for(int j=0; j<6; j++) {
+            ok &= putFloat(out, f[j]);
+            fprintf(out, ", ");
+        }
+        ok &= putFloat(out, s->_incidence + s->_twist);
+        fprintf(out, ", ");
+        ok &= putFloat(out, s->_inducedDrag);
+        fprintf(out, " },\n");
+        ngen++;
+    }
+    if(!ngen)
+        fprintf(out, "    { -1 }\n");
+    fprintf(out, "};\n\n");
+
+    // The force function, one call per surface
+    fprintf(out, "static void calcAero(float* wind, float* controls, float rho,\n"
+                 "                     float* force, float* moment)\n{\n");
+    fprintf(out, "    int i;\n");
+    fprintf(out, "    for(i=0; i<3; i++) force[i] = moment[i] = 0;\n");
+    int k = 0;
+    for(i=0; i<m->numSurfaces(); i++) {
+        Surface* s = m->getSurface(i);
+        if(s->_cx == 0 && s->_cy == 0 && s->_cz == 0)
+            continue;
+        fprintf(out, "    GeneratedAircraft::addSurface(SURFACES[%d], wind+%d,"
+                " controls+%d,\n                                  rho, force,"
+                " moment);\n", k++, 3*i, NCONTROLS*i);
+    }
+    fprintf(out, "}\n\n");
+
+    // The descriptor
+    fprintf(out, "extern const GeneratedAircraft gen_%s = {\n", name);
+    fprintf(out, "    \"%s\", \"%s\",\n", name, source);
+    fprintf(out, "    %d, %d, SURFACES,\n", m->numSurfaces(), ngen);
+    fprintf(out, "    ");
+    ok &= putFloat(out, a->getDragCoefficient());
+    fprintf(out, ", ");
+    ok &= putFloat(out, a->getLiftRatio());
+    fprintf(out, ", ");
+    ok &= putFloat(out, a->getCruiseAoA());
+    fprintf(out, ", ");
+    ok &= putFloat(out, a->getTailIncidence());
+    fprintf(out, ",\n    calcAero\n};\n\n");
+    fprintf(out, "}; // namespace yasim\n");
+    return ok;
+}
+
+void GeneratedAircraft::getControls(Model* m, float* out)
+{
+    for(int i=0; i<m->numSurfaces(); i++) {
+        Surface* s = m->getSurface(i);
+        float* c = out + NCONTROLS*i;
+        c[FLAP] = s->flapPos();
+        c[FLAPEFF] = s->flapEffectiveness();
+        c[SLAT] = s->slatPos();
+        c[SPOILER] = s->spoilerPos();
+    }
+}
+
+}; // namespace yasim
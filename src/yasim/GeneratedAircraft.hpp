@@ -0,0 +1,202 @@
+#ifndef _GENERATEDAIRCRAFT_HPP
+#define _GENERATEDAIRCRAFT_HPP
+
+#include <cstdio>
+
+#include "Math.hpp"
+
+// The surface kernel has to be inlined at every call in a generated
+// unit for the compiler to fold that surface's constants into it.
+#ifdef __GNUC__
+#define YASIM_GEN_INLINE inline __attribute__((always_inline))
+#else
+#define YASIM_GEN_INLINE inline
+#endif
+
+namespace yasim {
+
+class Airplane;
+class Model;
+class Surface;
+
+//
+// An aircraft's surfaces compiled to C++.  yasim-gen reads an
+// aircraft XML, solves it, and writes a translation unit holding the
+// solved surfaces as a constexpr array, plus an aerodynamic force
+// function with one inlined call per surface, so that the compiler
+// sees every coefficient of the airframe as a constant.  Masses, gear
+// and thrusters are not generated; they stay with the Model.  CMake builds one library per file listed in
+// YASIM_GENERATED_AIRCRAFT, and a yasim-gencheck-<name> program that
+// compares it against the generic model.
+//
+// Surfaces are in the Model's order, less those with no force
+// coefficients at all.  Each takes its airflow from wind[3*i] and its
+// control positions from controls[NCONTROLS*i] (see getControls()),
+// where i is the Model's surface handle.
+//
+struct GeneratedAircraft {
+    enum { FLAP, FLAPEFF, SLAT, SPOILER, NCONTROLS };
+
+    struct SurfaceRec {
+        int handle;
+        int live;   // (1<<FLAP) etc. for the controls that can move
+        float pos[3];
+        float orient[9];
+        float c0, cx, cy, cz, cz0, chord;
+        float peaks[2];
+        float stalls[4];
+        float widths[4];
+        float slatAlpha, slatDrag;
+        float flapLift, flapDrag;
+        float spoilerLift, spoilerDrag;
+        float incidence; // including twist
+        float inducedDrag;
+    };
+
+    const char* name;
+    const char* source;  // the XML it was generated from
+
+    int numSurfaces;     // as in the Model, for the wind and controls
+    int numGenerated;    // in the surfaces array
+    const SurfaceRec* surfaces;
+
+    // The solution
+    float dragFactor, liftRatio, cruiseAoA, tailIncidence;
+
+    // Total aerodynamic force, and moment about the local origin, of
+    // all surfaces, as Surface::calcForce() computes them.
+    void (*calcAero)(float* wind, float* controls, float rho,
+                     float* force, float* moment);
+
+    // Writes the generated unit for a compiled airplane.  The name
+    // must be a C identifier; the unit defines yasim::gen_<name>.
+    static bool write(Airplane* a, const char* name, const char* source,
+                      FILE* out);
+
+    // Packs every surface's control positions, NCONTROLS per surface.
+    static void getControls(Model* m, float* out);
+
+    // Surface::calcForce(), for constant s, added into force and
+    // moment.  Controls that are not live are skipped rather than
+    // multiplied by zero.
+    static YASIM_GEN_INLINE void addSurface(const SurfaceRec& s, float* v,
+                                            float* c, float rho,
+                                            float* force, float* moment);
+
+private:
+    static int liveControls(Surface* s);
+};
+
+YASIM_GEN_INLINE void GeneratedAircraft::addSurface(const SurfaceRec& s,
+                                                    float* v, float* c,
+                                                    float rho, float* force,
+                                                    float* moment)
+{
+    float vel = Math::mag3(v);
+    if(vel == 0) return;
+
+    float ivel = 1/vel;
+    float x = ivel*v[0], y = ivel*v[1], z = ivel*v[2];
+    float sx = x*s.orient[0] + y*s.orient[1] + z*s.orient[2];
+    float sy = x*s.orient[3] + y*s.orient[4] + z*s.orient[5];
+    float sz = x*s.orient[6] + y*s.orient[7] + z*s.orient[8];
+    if(s.incidence != 0) sz += s.incidence * sx;
+    float lx = sx, ly = sy, lz = sz;
+
+    // stallFunc()
+    float stallMul = 1;
+    if(sx != 0) {
+        float alpha = Math::abs(sz/sx);
+        int fwdBak = sx > 0;
+        int posNeg = sz < 0;
+        int i = (fwdBak<<1) | posNeg;
+        float stallAlpha = s.stalls[i];
+        if(stallAlpha != 0) {
+            if(i == 0) stallAlpha += s.slatAlpha;
+            if(alpha <= stallAlpha+s.widths[i]) {
+                float scale = 0.5f*s.peaks[fwdBak]/s.stalls[i&2];
+                if(alpha <= stallAlpha) {
+                    stallMul = scale;
+                } else {
+                    float frac = (alpha - stallAlpha) / s.widths[i];
+                    frac = frac*frac*(3-2*frac);
+                    stallMul = scale*(1-frac) + frac;
+                }
+            }
+        }
+    }
+    if(s.live & (1<<SPOILER))
+        stallMul *= 1 + c[SPOILER] * (s.spoilerLift - 1);
+    float stallLift = (stallMul - 1) * s.cz * sz;
+
+    // flapLift()
+    float flaplift = 0;
+    if((s.live & (1<<FLAP)) && s.stalls[0] != 0) {
+        flaplift = s.cz * c[FLAP] * (s.flapLift-1) * c[FLAPEFF];
+        float alpha = sz < 0 ? -sz : sz;
+        if(alpha > s.stalls[0] + s.widths[0]) {
+            flaplift = 0;
+        } else if(alpha >= s.stalls[0]) {
+            float frac = (alpha - s.stalls[0]) / s.widths[0];
+            frac = frac*frac*(3-2*frac);
+            flaplift *= 1-frac;
+        }
+    }
+
+    sz *= s.cz;
+    sz += s.cz*s.cz0;
+    sz += stallLift;
+    sz += flaplift;
+
+    float t[3];
+    t[0] = 0;
+    t[1] = 0.1667f * s.chord * (flaplift - (s.cz*s.cz0 + stallLift));
+    t[2] = 0;
+    Math::tmul33((float*)s.orient, t, t);
+
+    // controlDrag()
+    float drag = s.cx * sx;
+    if(s.live & (1<<FLAP)) {
+        float fp = c[FLAP];
+        if(fp < 0) {
+            fp = -fp;
+            fp -= s.cz0/(s.flapLift-1);
+            if(fp < 0) fp = 0;
+        }
+        float fd = Math::abs(sz * ((s.flapLift - 1 - s.cz0) * s.stalls[0])
+                             * fp);
+        if(drag < 0) fd = -fd;
+        drag += fd;
+        drag *= 1 + fp * (s.flapDrag - 1);
+    }
+    if(s.live & (1<<SPOILER)) drag *= 1 + c[SPOILER] * (s.spoilerDrag - 1);
+    if(s.live & (1<<SLAT)) drag *= 1 + c[SLAT] * (s.slatDrag - 1);
+    sx = drag;
+
+    sy *= s.cy;
+
+    // Induced drag
+    if(s.inducedDrag != 0) {
+        float k = -1*s.inducedDrag*sz*lz;
+        sx = k*lx + sx;
+        sy = k*ly + sy;
+        sz = k*lz + sz;
+    }
+
+    if(s.incidence != 0) sz -= s.incidence * sx;
+
+    float f[3], tmp[3];
+    f[0] = sx; f[1] = sy; f[2] = sz;
+    Math::tmul33((float*)s.orient, f, f);
+    float scale = 0.5f*rho*vel*vel*s.c0;
+    Math::mul3(scale, f, f);
+    Math::mul3(scale, t, t);
+
+    Math::add3(f, force, force);
+    Math::cross3((float*)s.pos, f, tmp);
+    Math::add3(tmp, moment, moment);
+    Math::add3(t, moment, moment);
+}
+
+}; // namespace yasim
+#endif // _GENERATEDAIRCRAFT_HPP
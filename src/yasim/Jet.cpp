@@ -1,5 +1,6 @@
 #include "Atmosphere.hpp"
 #include "Math.hpp"
+#include "StateHash.hpp"
 #include "Jet.hpp"
 namespace yasim {
 
@@ -234,4 +235,22 @@ void Jet::getGyro(float* out)
     return;
 }
 
+void Jet::hashState(StateHash* h)
+{
+    Thruster::hashState(h);
+    h->add(_reheat);
+    h->add(_reverseThrust);
+    h->add(_rotControl);
+    h->add(_running);
+    h->add(_cranking);
+    h->add(_thrust);
+    h->add(_epr);
+    h->add(_n1);
+    h->add(_n2);
+    h->add(_fuelFlow);
+    h->add(_egt);
+    h->add(_tempCorrect);
+    h->add(_pressureCorrect);
+}
+
 }; // namespace yasim
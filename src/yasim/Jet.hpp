@@ -51,6 +51,10 @@ public:
     virtual float getFuelFlow();
     virtual void integrate(float dt);
     virtual void stabilize();
+    virtual void hashState(StateHash* h);
+
+    // The spool-up is integrated implicitly, and takes seconds.
+    virtual float getUpdateRate() { return 50; }
 
 private:
     float _reheat;
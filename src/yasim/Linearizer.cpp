@@ -0,0 +1,320 @@
+#include <cstring>
+#include <thread>
+
+#include "Math.hpp"
+#include "Model.hpp"
+#include "Thruster.hpp"
+#include "Airplane.hpp"
+
+#include "Linearizer.hpp"
+namespace yasim {
+
+static const char* STATE_NAMES[] = { "u", "v", "w", "p", "q", "r",
+                                     "phi", "theta", "psi" };
+
+Linearizer::Linearizer(Airplane* airplane)
+{
+    _airplanes.add(airplane);
+    _nevals = 0;
+    _results = 0;
+    _b = 0;
+
+    int i;
+    for(i=0; i<NSTATES; i++) {
+        _xdot0[i] = 0;
+        _stateDelta[i] = i < P ? 0.1f : (i < PHI ? 0.01f : 0.001f);
+    }
+    for(i=0; i<NSTATES*NSTATES; i++)
+        _a[i] = 0;
+}
+
+Linearizer::~Linearizer()
+{
+    int i;
+    for(i=0; i<_inputs.size(); i++) {
+        InputRec* in = (InputRec*)_inputs.get(i);
+        delete[] in->name;
+        delete in;
+    }
+    for(i=0; i<_trimInputs.size(); i++)
+        delete (TrimRec*)_trimInputs.get(i);
+    delete[] _results;
+    delete[] _b;
+}
+
+void Linearizer::addClone(Airplane* airplane)
+{
+    _airplanes.add(airplane);
+}
+
+void Linearizer::setTrimState(State* s)
+{
+    _trim = *s;
+}
+
+void Linearizer::setTrimInput(int input, float val)
+{
+    for(int i=0; i<_trimInputs.size(); i++) {
+        TrimRec* t = (TrimRec*)_trimInputs.get(i);
+        if(t->input == input) {
+            t->val = val;
+            return;
+        }
+    }
+    TrimRec* t = new TrimRec();
+    t->input = input;
+    t->val = val;
+    _trimInputs.add(t);
+}
+
+float Linearizer::getTrimInput(int input)
+{
+    for(int i=0; i<_trimInputs.size(); i++) {
+        TrimRec* t = (TrimRec*)_trimInputs.get(i);
+        if(t->input == input)
+            return t->val;
+    }
+    return 0;
+}
+
+void Linearizer::addInput(int input, const char* name, float delta)
+{
+    InputRec* in = new InputRec();
+    in->input = input;
+    in->name = new char[strlen(name)+1];
+    strcpy(in->name, name);
+    in->delta = delta;
+    _inputs.add(in);
+}
+
+void Linearizer::setStateDelta(int state, float delta)
+{
+    _stateDelta[state] = delta;
+}
+
+const char* Linearizer::getStateName(int state)
+{
+    return STATE_NAMES[state];
+}
+
+const char* Linearizer::getInputName(int input)
+{
+    return ((InputRec*)_inputs.get(input))->name;
+}
+
+// Fills in the state and input vectors for evaluation number "eval".
+// Evaluations come in +/- pairs, first for each state and then for
+// each input.  An eval of -1 is the unperturbed trim point.
+void Linearizer::perturb(int eval, float* x, float* u)
+{
+    int i;
+    for(i=0; i<NSTATES; i++)
+        x[i] = 0;
+    for(i=0; i<_inputs.size(); i++)
+        u[i] = getTrimInput(((InputRec*)_inputs.get(i))->input);
+    if(eval < 0)
+        return;
+
+    int col = eval / 2;
+    float sign = (eval & 1) ? -1 : 1;
+    if(col < NSTATES) {
+        x[col] = sign * _stateDelta[col];
+    } else {
+        col -= NSTATES;
+        u[col] += sign * ((InputRec*)_inputs.get(col))->delta;
+    }
+}
+
+// Sets the airplane up at the trim point offset by x and u, and
+// computes the state derivatives.  This mirrors what the solver does
+// in Airplane::runCruise().
+void Linearizer::evaluate(Airplane* airplane, float* x, float* u, float* xdot)
+{
+    Model* model = airplane->getModel();
+    ControlMap* cm = airplane->getControlMap();
+
+    int i;
+    cm->reset();
+    for(i=0; i<_trimInputs.size(); i++) {
+        TrimRec* t = (TrimRec*)_trimInputs.get(i);
+        cm->setInput(t->input, t->val);
+    }
+    for(i=0; i<_inputs.size(); i++)
+        cm->setInput(((InputRec*)_inputs.get(i))->input, u[i]);
+    cm->applyControls(1000000); // Huge dt value
+
+    // Rotate the body by the small attitude deviation (a rotation
+    // vector in body axes), then apply the body-axis velocity and
+    // rotation rate perturbations in the new frame.
+    float* att = x + PHI;
+    float ang = Math::mag3(att);
+    float rot[9], tmp[9];
+    if(ang > 0) {
+        float ax[3], c = Math::cos(ang), s = Math::sin(ang), t = 1 - c;
+        Math::mul3(1/ang, att, ax);
+        rot[0] = t*ax[0]*ax[0] + c;
+        rot[1] = t*ax[0]*ax[1] - s*ax[2];
+        rot[2] = t*ax[0]*ax[2] + s*ax[1];
+        rot[3] = t*ax[1]*ax[0] + s*ax[2];
+        rot[4] = t*ax[1]*ax[1] + c;
+        rot[5] = t*ax[1]*ax[2] - s*ax[0];
+        rot[6] = t*ax[2]*ax[0] - s*ax[1];
+        rot[7] = t*ax[2]*ax[1] + s*ax[0];
+        rot[8] = t*ax[2]*ax[2] + c;
+    } else {
+        for(i=0; i<9; i++)
+            rot[i] = (i%4 == 0) ? 1 : 0;
+    }
+
+    State s = _trim;
+    Math::trans33(rot, tmp);
+    Math::mmul33(tmp, _trim.orient, s.orient);
+
+    float lv[3], lrot[3];
+    Math::vmul33(_trim.orient, _trim.v, lv);
+    Math::add3(lv, x + U, lv);
+    Math::tmul33(s.orient, lv, s.v);
+    Math::vmul33(_trim.orient, _trim.rot, lrot);
+    Math::add3(lrot, x + P, lrot);
+    Math::tmul33(s.orient, lrot, s.rot);
+
+    model->setState(&s);
+    State* ms = model->getState();
+
+    // The local wind, and stabilized thrust
+    float wind[3];
+    Math::mul3(-1, ms->v, wind);
+    Math::vmul33(ms->orient, wind, wind);
+    for(i=0; i<airplane->numThrusters(); i++)
+        airplane->getThruster(i)->setWind(wind);
+    airplane->stabilizeThrust();
+
+    model->getBody()->recalc();
+    model->getBody()->reset();
+    model->initIteration(1.0/30);
+    model->calcForces(ms);
+
+    // Body axis derivatives: the velocity derivative seen in a
+    // rotating frame is the inertial acceleration minus rot x v.
+    float acc[3], racc[3];
+    model->getBody()->getAccel(acc);
+    model->getBody()->getAngularAccel(racc);
+    Math::cross3(lrot, lv, tmp);
+    Math::sub3(acc, tmp, xdot + U);
+    Math::set3(racc, xdot + P);
+    Math::set3(lrot, xdot + PHI);
+}
+
+void Linearizer::runWorker(Worker* w)
+{
+    Linearizer* lin = w->lin;
+    int stride = lin->_airplanes.size();
+    float x[NSTATES];
+    float* u = new float[lin->_inputs.size() + 1];
+    for(int e=w->idx; e<lin->_nevals; e+=stride) {
+        lin->perturb(e, x, u);
+        lin->evaluate(w->airplane, x, u, lin->_results + e*NSTATES);
+    }
+    delete[] u;
+}
+
+void Linearizer::linearize()
+{
+    int i, j;
+    int nin = _inputs.size();
+    int nworkers = _airplanes.size();
+
+    delete[] _results;
+    delete[] _b;
+    _nevals = 2 * (NSTATES + nin);
+    _results = new float[_nevals * NSTATES];
+    _b = new float[NSTATES * nin + 1];
+
+    // Turbulence would make the derivatives depend on where each
+    // evaluation happens to sample it.  Run in still air.
+    Turbulence** turb = new Turbulence*[nworkers];
+    for(i=0; i<nworkers; i++) {
+        Model* m = ((Airplane*)_airplanes.get(i))->getModel();
+        turb[i] = m->getTurbulence();
+        m->setTurbulence(0);
+    }
+
+    Worker* workers = new Worker[nworkers];
+    std::thread* threads = new std::thread[nworkers];
+    for(i=0; i<nworkers; i++) {
+        workers[i].lin = this;
+        workers[i].airplane = (Airplane*)_airplanes.get(i);
+        workers[i].idx = i;
+        if(i > 0)
+            threads[i] = std::thread(runWorker, &workers[i]);
+    }
+    runWorker(&workers[0]);
+    for(i=1; i<nworkers; i++)
+        threads[i].join();
+    delete[] threads;
+    delete[] workers;
+
+    // Central differences
+    for(j=0; j<NSTATES + nin; j++) {
+        float* plus = _results + (2*j)*NSTATES;
+        float* minus = _results + (2*j+1)*NSTATES;
+        float delta = j < NSTATES ? _stateDelta[j]
+            : ((InputRec*)_inputs.get(j - NSTATES))->delta;
+        for(i=0; i<NSTATES; i++) {
+            float d = (plus[i] - minus[i]) / (2*delta);
+            if(j < NSTATES) _a[i*NSTATES + j] = d;
+            else            _b[i*nin + j - NSTATES] = d;
+        }
+    }
+
+    // Finish with the primary airplane back at the trim point.
+    float x[NSTATES];
+    float* u = new float[nin + 1];
+    perturb(-1, x, u);
+    evaluate((Airplane*)_airplanes.get(0), x, u, _xdot0);
+    delete[] u;
+
+    for(i=0; i<nworkers; i++)
+        ((Airplane*)_airplanes.get(i))->getModel()->setTurbulence(turb[i]);
+    delete[] turb;
+}
+
+void Linearizer::write(FILE* out)
+{
+    int i, j;
+    int nin = _inputs.size();
+
+    fprintf(out, "%% YASim linearization, xdot = A*x + B*u\n");
+    fprintf(out, "%% Body axes, SI units, angles in radians.\n");
+    fprintf(out, "state_names = {");
+    for(i=0; i<NSTATES; i++)
+        fprintf(out, "%s'%s'", i ? ", " : "", STATE_NAMES[i]);
+    fprintf(out, "};\n");
+    fprintf(out, "input_names = {");
+    for(i=0; i<nin; i++)
+        fprintf(out, "%s'%s'", i ? ", " : "", getInputName(i));
+    fprintf(out, "};\n");
+
+    fprintf(out, "xdot0 = [");
+    for(i=0; i<NSTATES; i++)
+        fprintf(out, " %g", _xdot0[i]);
+    fprintf(out, " ]';\n");
+
+    fprintf(out, "A = [\n");
+    for(i=0; i<NSTATES; i++) {
+        for(j=0; j<NSTATES; j++)
+            fprintf(out, " %12g", getA(i, j));
+        fprintf(out, "\n");
+    }
+    fprintf(out, "];\n");
+
+    fprintf(out, "B = [\n");
+    for(i=0; i<NSTATES; i++) {
+        for(j=0; j<nin; j++)
+            fprintf(out, " %12g", getB(i, j));
+        fprintf(out, "\n");
+    }
+    fprintf(out, "];\n");
+}
+
+}; // namespace yasim
@@ -0,0 +1,110 @@
+#ifndef _LINEARIZER_HPP
+#define _LINEARIZER_HPP
+
+#include <cstdio>
+
+#include "BodyEnvironment.hpp"
+#include "Vector.hpp"
+
+namespace yasim {
+
+class Airplane;
+
+//
+// Computes a linear state-space model (xdot = A*x + B*u) of an
+// Airplane about a trimmed flight condition, by central finite
+// differences of the full Model::calcForces() evaluation.
+//
+// The state vector is the body-axis one usually wanted for control
+// design, all in the local (aircraft) coordinate system:
+//
+//   u, v, w    velocity of the c.g. (m/s)
+//   p, q, r    rotation rate (rad/s)
+//   phi, theta, psi   small attitude deviation about the body axes (rad)
+//
+// The input vector is any set of ControlMap inputs.  Each perturbed
+// evaluation re-applies the controls, re-stabilizes the thrusters and
+// recomputes the forces, so throttle columns contain the
+// quasi-steady engine response.
+//
+// Evaluations are independent of each other.  They can be spread
+// across several identically configured copies of the airplane (see
+// addClone()), each worked on by its own thread.  Every evaluation
+// starts from the same configuration, so the result does not depend
+// on the number of copies.
+//
+class Linearizer {
+public:
+    enum { U, V, W, P, Q, R, PHI, THETA, PSI, NSTATES };
+
+    Linearizer(Airplane* airplane);
+    ~Linearizer();
+
+    // Adds another copy of the airplane to be used as a parallel
+    // worker.  It must have been loaded from the same definition and
+    // put into the same configuration (air, fuel, weights) as the
+    // primary airplane.
+    void addClone(Airplane* airplane);
+
+    // The trimmed state to linearize about.
+    void setTrimState(State* s);
+
+    // The value of a ControlMap input at the trim point.  Inputs not
+    // mentioned here or in addInput() are held at zero.
+    void setTrimInput(int input, float val);
+
+    // Adds a ControlMap input to be perturbed.  Each one becomes a
+    // column of B.  The name is used only for the exported output.
+    void addInput(int input, const char* name, float delta=0.01f);
+
+    // Perturbation sizes for the state columns of A.  Defaults are
+    // 0.1 m/s, 0.01 rad/s and 0.001 rad.
+    void setStateDelta(int state, float delta);
+
+    // Does the work.  On return the primary airplane is left in the
+    // trim configuration.
+    void linearize();
+
+    int numStates() { return NSTATES; }
+    int numInputs() { return _inputs.size(); }
+    static const char* getStateName(int state);
+    const char* getInputName(int input);
+
+    float getA(int row, int col) { return _a[row*NSTATES + col]; }
+    float getB(int row, int col) { return _b[row*_inputs.size() + col]; }
+
+    // The state derivatives at the trim point.  Near zero for a good
+    // trim.
+    float getTrimDerivative(int state) { return _xdot0[state]; }
+
+    // Writes A and B, with state and input names, as Octave/MATLAB
+    // assignments for use by control design tools.
+    void write(FILE* out);
+
+private:
+    struct InputRec { int input; char* name; float delta; };
+    struct TrimRec { int input; float val; };
+    struct Worker { Linearizer* lin; Airplane* airplane; int idx; };
+
+    float getTrimInput(int input);
+    void perturb(int eval, float* x, float* u);
+    void evaluate(Airplane* airplane, float* x, float* u, float* xdot);
+    static void runWorker(Worker* w);
+
+    Vector _airplanes;
+    Vector _inputs;
+    Vector _trimInputs;
+
+    State _trim;
+    float _stateDelta[NSTATES];
+
+    int _nevals;
+    float* _results; // NSTATES derivatives per evaluation
+
+    float _a[NSTATES*NSTATES];
+    float* _b;
+    float _xdot0[NSTATES];
+};
+
+}; // namespace yasim
+#endif // _LINEARIZER_HPP
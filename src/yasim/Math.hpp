@@ -3,6 +3,14 @@
 
 #include <math.h>
 
+#include "FastMath.hpp"
+
+// The accuracy of the tiered functions (Math::fsin() etc.): 0 for
+// the C library, 1 for about 1e-6, 2 for about 1e-4.
+#ifndef YASIM_MATH_TIER
+#define YASIM_MATH_TIER 0
+#endif
+
 namespace yasim {
 
 class Math
@@ -32,6 +40,38 @@ public:
     // Takes two args and runs afoul of the Koenig rules.
     static inline float pow(double base, double exp) { return (float)::pow(base, exp); }
 
+    // Tiered versions of the transcendental functions, for the hot
+    // paths: the C library (EXACT) or the FastMath approximations
+    // (PRECISE or FAST).  The tier is YASIM_MATH_TIER, fixed at compile
+    // time, so these are direct calls with nothing to decide at run
+    // time, and the same for every thread.
+    enum { EXACT = FastMath::EXACT, PRECISE = FastMath::PRECISE,
+           FAST = FastMath::FAST, TIER = YASIM_MATH_TIER };
+
+#if YASIM_MATH_TIER == 0
+    static inline float fsin(float f) { return sin(f); }
+    static inline float fcos(float f) { return cos(f); }
+    static inline double fsin(double f) { return sin(f); }
+    static inline double fcos(double f) { return cos(f); }
+    static inline float fatan(float f) { return atan(f); }
+    static inline float fatan2(float y, float x) { return atan2(y, x); }
+    static inline float fpow(double base, double exp) { return pow(base, exp); }
+    static inline float fexp(float f) { return exp(f); }
+#else
+    static inline float fsin(float f) { return FastMath::sin<TIER>(f); }
+    static inline float fcos(float f) { return FastMath::cos<TIER>(f); }
+    static inline double fsin(double f) { return fsin((float)f); }
+    static inline double fcos(double f) { return fcos((float)f); }
+    static inline float fatan(float f) { return FastMath::atan<TIER>(f); }
+    static inline float fatan2(float y, float x) {
+        return FastMath::atan2<TIER>(y, x);
+    }
+    static inline float fpow(double base, double exp) {
+        return FastMath::pow<TIER>(base, exp);
+    }
+    static inline float fexp(float f) { return FastMath::exp<TIER>(f); }
+#endif
+
     // double variants of the above
     static inline double abs(double f)  { return ::fabs(f); }
     static inline double sqrt(double f) { return ::sqrt(f); }
@@ -3,6 +3,10 @@
 #  include "config.h"
 #endif
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "Atmosphere.hpp"
 #include "Thruster.hpp"
 #include "Math.hpp"
@@ -14,15 +18,27 @@
 #include "Hook.hpp"
 #include "Launchbar.hpp"
 #include "Surface.hpp"
+#include "AeroDatabase.hpp"
 #include "Rotor.hpp"
 #include "Rotorpart.hpp"
 #include "Hitch.hpp"
 #include "Glue.hpp"
 #include "Ground.hpp"
+#include "StateHash.hpp"
 
 #include "Model.hpp"
 namespace yasim {
 
+// The force breakdown (see ForceBreakdown.hpp) costs nothing unless
+// it is compiled in.
+#ifdef YASIM_FORCE_BREAKDOWN
+#define RECORD_FORCE(cat, pos, force) recordForce(cat, pos, force)
+#define RECORD_TORQUE(cat, torque) recordTorque(cat, torque)
+#else
+#define RECORD_FORCE(cat, pos, force)
+#define RECORD_TORQUE(cat, torque)
+#endif
+
 #if 0
 void printState(State* s)
 {
@@ -62,6 +78,19 @@ Model::Model()
     _ground_cb = new Ground();
     _hook = 0;
     _launchbar = 0;
+    _aeroDb = 0;
+
+    _surfaceCats = 0;
+#ifdef YASIM_FORCE_BREAKDOWN
+    _breakdown.clear();
+    _recordBreakdown = false;
+#endif
+
+    _wfState = 0;
+    _windBufSize = 0;
+    _windPos = _windOut = _windUp = _windTurb = 0;
+    _windGPos = 0;
+    _rotorWorkers = 0;
 
     _groundEffectSpan = 0;
     _groundEffect = 0;
@@ -80,7 +109,14 @@ Model::~Model()
     delete _launchbar;
     for(int i=0; i<_hitches.size();i++)
         delete (Hitch*)_hitches.get(i);
+    stopRotorWorkers();
 
+    delete[] _windPos;
+    delete[] _windOut;
+    delete[] _windUp;
+    delete[] _windTurb;
+    delete[] _windGPos;
+    delete[] _surfaceCats;
 }
 
 void Model::getThrust(float* out)
@@ -106,26 +142,31 @@ void Model::initIteration(float dt)
     float lground[4];
     _s->planeGlobalToLocal(_global_ground, lground);
     float alt = Math::abs(lground[3]);
+    setWindFrame(_s, alt);
 
-    for(i=0; i<_thrusters.size(); i++) {
-	Thruster* t = (Thruster*)_thrusters.get(i);
-	
-        // Get the wind velocity at the thruster location
-        float pos[3], v[3];
-	t->getPosition(pos);
-        localWind(pos, _s, v, alt);
-
-	t->setWind(v);
-	t->setAir(_pressure, _temp, _rho);
-	t->integrate(dt);
-
-	t->getTorque(v);
-	Math::add3(v, _torque, _torque);
+#ifdef YASIM_FORCE_BREAKDOWN
+    // Record the first calcForces() of this step
+    _breakdown.clear();
+    _recordBreakdown = true;
+#endif
 
-	t->getGyro(v);
-	Math::add3(v, _gyro, _gyro);
+    // The wind at every thruster, then all of them integrated by
+    // type.  The torques and angular momenta are summed in the
+    // Model's order, whatever the types.
+    int n = _thrusterBank.size();
+    growWindBuffers(n);
+    localWinds(n, _thrusterBank.getPositions(), _windOut);
+    _thrusterBank.integrate(_windOut, _pressure, _temp, _rho, dt);
+    for(i=0; i<n; i++) {
+	Math::add3(_thrusterBank.getTorque(i), _torque, _torque);
+	RECORD_TORQUE(ForceBreakdown::thruster(i), _thrusterBank.getTorque(i));
+	Math::add3(_thrusterBank.getGyro(i), _gyro, _gyro);
     }
 
+    // Pack the surfaces, with their control settings for this
+    // iteration, for the force calculations.
+    _surfaceBank.load(&_surfaces);
+
     // Displace the turbulence coordinates according to the local wind.
     if(_turb) {
         float toff[3];
@@ -166,6 +207,26 @@ void Model::iterate(float dt)
     _integrator.calcNewInterval(dt);
 }
 
+void Model::hashState(StateHash* h)
+{
+    h->add(_s->pos, 3);
+    h->add(_s->orient, 9);
+    h->add(_s->v, 3);
+    h->add(_s->rot, 3);
+    h->add(_s->acc, 3);
+    h->add(_s->racc, 3);
+    h->add(_gyro, 3);
+    h->add(_torque, 3);
+    h->add(_crashed);
+    h->add(_agl);
+
+    int i;
+    for(i=0; i<_thrusters.size(); i++)
+        ((Thruster*)_thrusters.get(i))->hashState(h);
+    if(_rotorgear.isInUse())
+        _rotorgear.hashState(h);
+}
+
 bool Model::isCrashed()
 {
     return _crashed;
@@ -214,7 +275,9 @@ Rotorgear* Model::getRotorgear(void)
 
 int Model::addThruster(Thruster* t)
 {
-    return _thrusters.add(t);
+    int handle = _thrusters.add(t);
+    _thrusterBank.load(&_thrusters);
+    return handle;
 }
 
 Hook* Model::getHook(void)
@@ -240,11 +303,27 @@ Thruster* Model::getThruster(int handle)
 void Model::setThruster(int handle, Thruster* t)
 {
     _thrusters.set(handle, t);
+    _thrusterBank.load(&_thrusters);
 }
 
-int Model::addSurface(Surface* surf)
+float Model::setSurfaceTables(int resolution)
 {
-    return _surfaces.add(surf);
+    _surfaceBank.buildTables(&_surfaces, resolution);
+    return _surfaceBank.getTableError();
+}
+
+int Model::addSurface(Surface* surf, int category)
+{
+    int handle = _surfaces.add(surf);
+
+    int* cats = new int[handle+1];
+    for(int i=0; i<handle; i++)
+        cats[i] = _surfaceCats[i];
+    cats[handle] = category;
+    delete[] _surfaceCats;
+    _surfaceCats = cats;
+
+    return handle;
 }
 
 int Model::addGear(Gear* gear)
@@ -380,12 +459,11 @@ void Model::calcForces(State* s)
     _body.setGyro(_gyro);
     _body.addTorque(_torque);
     int i,j;
-    for(i=0; i<_thrusters.size(); i++) {
-	Thruster* t = (Thruster*)_thrusters.get(i);
-	float thrust[3], pos[3];
-	t->getThrust(thrust);
-	t->getPosition(pos);
+    for(i=0; i<_thrusterBank.size(); i++) {
+	float* thrust = _thrusterBank.getThrust(i);
+	float* pos = _thrusterBank.getPosition(i);
 	_body.addForce(pos, thrust);
+	RECORD_FORCE(ForceBreakdown::thruster(i), pos, thrust);
     }
 
     // Get a ground plane in local coordinates.  The first three
@@ -403,43 +481,38 @@ void Model::calcForces(State* s)
     Math::vmul33(s->orient, grav, grav);
     _body.addForce(grav);
 
-    // Do each surface, remembering that the local velocity at each
-    // point is different due to rotation.
-    float faero[3];
-    faero[0] = faero[1] = faero[2] = 0;
-    for(i=0; i<_surfaces.size(); i++) {
-	Surface* sf = (Surface*)_surfaces.get(i);
-
-	// Vsurf = wind - velocity + (rot cross (cg - pos))
-	float vs[3], pos[3];
-	sf->getPosition(pos);
-        localWind(pos, s, vs, alt);
+    setWindFrame(s, alt);
 
-	float force[3], torque[3];
-	sf->calcForce(vs, _rho, force, torque);
-	Math::add3(faero, force, faero);
+    float faero[3];
+    sumAeroForces(faero);
 
-	_body.addForce(pos, force);
-	_body.addTorque(torque);
-    }
-    for (j=0; j<_rotorgear.getRotors()->size();j++)
+    if(_rotorWorkers)
+        calcRotorForces(s);
+    for (j=0; !_rotorWorkers && j<_rotorgear.getRotors()->size();j++)
     {
         Rotor* r = (Rotor *)_rotorgear.getRotors()->get(j);
         float vs[3], pos[3];
         r->getPosition(pos);
-        localWind(pos, s, vs, alt);
+        localWind(pos, vs);
         r->calcLiftFactor(vs, _rho,s);
         float tq=0; 
         // total torque of rotor (scalar) for calculating new rotor rpm
 
-        for(i=0; i<r->_rotorparts.size(); i++) {
+        // The rotorparts see no downwash, so their airflow doesn't
+        // depend on the rotor's state and can be found all at once.
+        int nparts = r->_rotorparts.size();
+        growWindBuffers(nparts);
+        for(i=0; i<nparts; i++)
+            ((Rotorpart*)r->_rotorparts.get(i))->getPosition(_windPos+3*i);
+        localWinds(nparts, _windPos, _windOut, true);
+
+        for(i=0; i<nparts; i++) {
             float torque_scalar=0;
             Rotorpart* rp = (Rotorpart*)r->_rotorparts.get(i);
 
             // Vsurf = wind - velocity + (rot cross (cg - pos))
-            float vs[3], pos[3];
-            rp->getPosition(pos);
-            localWind(pos, s, vs, alt,true);
+            float* vs = _windOut + 3*i;
+            float pos[3];
 
             float force[3], torque[3];
             rp->calcForce(vs, _rho, force, torque, &torque_scalar);
@@ -448,6 +521,8 @@ void Model::calcForces(State* s)
 
             _body.addForce(pos, force);
             _body.addTorque(torque);
+            RECORD_FORCE(ForceBreakdown::ROTOR, pos, force);
+            RECORD_TORQUE(ForceBreakdown::ROTOR, torque);
         }
         r->setTorque(tq);
     }
@@ -456,6 +531,7 @@ void Model::calcForces(State* s)
         float torque[3];
         _rotorgear.calcForces(torque);
         _body.addTorque(torque);
+        RECORD_TORQUE(ForceBreakdown::ROTOR, torque);
     }
 
     // Account for ground effect by multiplying the vertical force
@@ -470,13 +546,13 @@ void Model::calcForces(State* s)
             fz *= _groundEffect;
         Math::mul3(fz, ground, faero);
         _body.addForce(faero);
+        RECORD_FORCE(ForceBreakdown::GROUND_EFFECT, 0, faero);
         }
     }
     
-    // Convert the velocity and rotation vectors to local coordinates
-    float lrot[3], lv[3];
-    Math::vmul33(s->orient, s->rot, lrot);
-    Math::vmul33(s->orient, s->v, lv);
+    // The velocity and rotation vectors in local coordinates
+    float* lrot = _wfRot;
+    float* lv = _wfV;
 
     // The landing gear
     for(i=0; i<_gears.size(); i++) {
@@ -486,6 +562,7 @@ void Model::calcForces(State* s)
 	g->calcForce(&_body, s, lv, lrot);
 	g->getForce(force, contact);
 	_body.addForce(contact, force);
+	RECORD_FORCE(ForceBreakdown::GEAR, contact, force);
     }
 
     // The arrester hook
@@ -494,6 +571,7 @@ void Model::calcForces(State* s)
 	float force[3], contact[3];
         _hook->getForce(force, contact);
         _body.addForce(contact, force);
+        RECORD_FORCE(ForceBreakdown::HOOK, contact, force);
     }
 
     // The launchbar/holdback
@@ -503,6 +581,8 @@ void Model::calcForces(State* s)
         _launchbar->getForce(forcelb, contactlb, forcehb, contacthb);
         _body.addForce(contactlb, forcelb);
         _body.addForce(contacthb, forcehb);
+        RECORD_FORCE(ForceBreakdown::LAUNCHBAR, contactlb, forcelb);
+        RECORD_FORCE(ForceBreakdown::LAUNCHBAR, contacthb, forcehb);
     }
 
 // The hitches
@@ -512,8 +592,261 @@ void Model::calcForces(State* s)
         h->calcForce(_ground_cb,&_body, s);
         h->getForce(force, contact);
         _body.addForce(contact, force);
+        RECORD_FORCE(ForceBreakdown::HITCH, contact, force);
+    }
+
+#ifdef YASIM_FORCE_BREAKDOWN
+    _recordBreakdown = false;
+#endif
+}
+
+// The shared state of the rotor threads.  For each batch the workers
+// (and the caller, as number zero) each take every n'th rotorpart,
+// and the last worker to finish wakes the caller.  The buffers hold
+// three floats per rotorpart, one for the scalar torque.
+struct RotorWorkers {
+    std::mutex lock;
+    std::condition_variable start, done;
+    std::thread* threads;
+    int nthreads;  // besides the caller
+    int batch;     // incremented for each batch
+    int pending;   // workers not yet done with it
+    bool quit;
+    float rho;
+    int nparts;
+    int size;
+    Rotorpart** parts;
+    float* wind;
+    float* force;
+    float* torque;
+    float* torqueScalar;
+};
+
+static void calcRotorparts(RotorWorkers* w, int idx)
+{
+    int stride = w->nthreads + 1;
+    for(int i=idx; i<w->nparts; i+=stride)
+        w->parts[i]->calcForce(w->wind+3*i, w->rho, w->force+3*i,
+                               w->torque+3*i, w->torqueScalar+i);
+}
+
+void Model::rotorWorker(RotorWorkers* w, int idx)
+{
+    int seen = 0;
+    while(1) {
+        {
+            std::unique_lock<std::mutex> l(w->lock);
+            while(w->batch == seen && !w->quit)
+                w->start.wait(l);
+            if(w->quit) return;
+            seen = w->batch;
+        }
+        calcRotorparts(w, idx);
+        std::lock_guard<std::mutex> l(w->lock);
+        if(--w->pending == 0)
+            w->done.notify_one();
+    }
+}
+
+// Evaluates the first n rotorparts in the buffers, on all threads.
+void Model::runRotorparts(int n)
+{
+    RotorWorkers* w = _rotorWorkers;
+    w->rho = _rho;
+    w->nparts = n;
+    if(!w->nthreads) {
+        calcRotorparts(w, 0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> l(w->lock);
+        w->pending = w->nthreads;
+        w->batch++;
+    }
+    w->start.notify_all();
+    calcRotorparts(w, 0);
+    std::unique_lock<std::mutex> l(w->lock);
+    while(w->pending)
+        w->done.wait(l);
+}
+
+// The rotors' part of calcForces() on the rotor threads: the lift
+// factors and airflows in the serial order first, then every
+// rotorpart at once, then the forces and torques summed, and the
+// flapping angles committed, in the serial order again.
+void Model::calcRotorForces(State* s)
+{
+    RotorWorkers* w = _rotorWorkers;
+    Vector* rotors = _rotorgear.getRotors();
+    int i, j, n;
+
+    for(n=0, j=0; j<rotors->size(); j++)
+        n += ((Rotor*)rotors->get(j))->_rotorparts.size();
+    if(n > w->size) {
+        delete[] w->parts;
+        delete[] w->wind;
+        delete[] w->force;
+        delete[] w->torque;
+        delete[] w->torqueScalar;
+        w->parts = new Rotorpart*[n];
+        w->wind = new float[3*n];
+        w->force = new float[3*n];
+        w->torque = new float[3*n];
+        w->torqueScalar = new float[n];
+        w->size = n;
+    }
+
+    for(n=0, j=0; j<rotors->size(); j++) {
+        Rotor* r = (Rotor*)rotors->get(j);
+        float vs[3], pos[3];
+        r->getPosition(pos);
+        localWind(pos, vs);
+        r->calcLiftFactor(vs, _rho, s);
+
+        int nparts = r->_rotorparts.size();
+        growWindBuffers(nparts);
+        for(i=0; i<nparts; i++) {
+            w->parts[n+i] = (Rotorpart*)r->_rotorparts.get(i);
+            w->parts[n+i]->getPosition(_windPos+3*i);
+        }
+        localWinds(nparts, _windPos, w->wind+3*n, true);
+        n += nparts;
+    }
+
+    runRotorparts(n);
+
+    for(n=0, j=0; j<rotors->size(); j++) {
+        Rotor* r = (Rotor*)rotors->get(j);
+        float tq=0;
+        int nparts = r->_rotorparts.size();
+        for(i=0; i<nparts; i++, n++) {
+            Rotorpart* rp = w->parts[n];
+            float* force = w->force + 3*n;
+            float* torque = w->torque + 3*n;
+            float pos[3];
+            rp->commit();
+            tq += w->torqueScalar[n];
+            rp->getPositionForceAttac(pos);
+
+            _body.addForce(pos, force);
+            _body.addTorque(torque);
+            RECORD_FORCE(ForceBreakdown::ROTOR, pos, force);
+            RECORD_TORQUE(ForceBreakdown::ROTOR, torque);
+        }
+        r->setTorque(tq);
+    }
+}
+
+void Model::setRotorThreads(int n)
+{
+    stopRotorWorkers();
+    Vector* rotors = _rotorgear.getRotors();
+    for(int j=0; j<rotors->size(); j++) {
+        Rotor* r = (Rotor*)rotors->get(j);
+        for(int i=0; i<r->_rotorparts.size(); i++)
+            ((Rotorpart*)r->_rotorparts.get(i))->setDeferred(n > 0);
+    }
+    if(n <= 0)
+        return;
+
+    RotorWorkers* w = new RotorWorkers();
+    w->nthreads = n - 1;
+    w->threads = new std::thread[w->nthreads];
+    w->batch = w->pending = 0;
+    w->quit = false;
+    w->rho = 0;
+    w->nparts = w->size = 0;
+    w->parts = 0;
+    w->wind = w->force = w->torque = w->torqueScalar = 0;
+    for(int i=0; i<w->nthreads; i++)
+        w->threads[i] = std::thread(rotorWorker, w, i+1);
+    _rotorWorkers = w;
+}
+
+int Model::getRotorThreads()
+{
+    return _rotorWorkers ? _rotorWorkers->nthreads + 1 : 0;
+}
+
+void Model::stopRotorWorkers()
+{
+    RotorWorkers* w = _rotorWorkers;
+    if(!w)
+        return;
+    {
+        std::lock_guard<std::mutex> l(w->lock);
+        w->quit = true;
     }
+    w->start.notify_all();
+    for(int i=0; i<w->nthreads; i++)
+        w->threads[i].join();
+    delete[] w->threads;
+    delete[] w->parts;
+    delete[] w->wind;
+    delete[] w->force;
+    delete[] w->torque;
+    delete[] w->torqueScalar;
+    delete w;
+    _rotorWorkers = 0;
+}
+
+void Model::calcAeroForces(State* s, float alt, float* faero)
+{
+    setWindFrame(s, alt);
+    sumAeroForces(faero);
 }
+
+void Model::sumAeroForces(float* faero)
+{
+    int i;
+    faero[0] = faero[1] = faero[2] = 0;
+
+    // The table driven model sees only the airflow at the origin,
+    // and its moment is about the origin, not the c.g.
+    if(_aeroDb) {
+        float zero[3], va[3], moment[3], cg[3], tmp[3];
+        zero[0] = zero[1] = zero[2] = 0;
+        localWind(zero, va);
+        _aeroDb->calcForces(va, _wfRot, _rho, faero, moment);
+
+        _body.getCG(cg);
+        Math::cross3(cg, faero, tmp);
+        Math::sub3(moment, tmp, moment);
+        _body.addForce(faero);
+        _body.addTorque(moment);
+        RECORD_FORCE(ForceBreakdown::AERO_TABLE, 0, faero);
+        RECORD_TORQUE(ForceBreakdown::AERO_TABLE, moment);
+        return;
+    }
+
+    // Do each surface, remembering that the local velocity at each
+    // point is different due to rotation.  The forces are computed
+    // for all surfaces at once by the SurfaceBank.
+    if(_surfaceBank.size() != _surfaces.size())
+        _surfaceBank.load(&_surfaces);
+    int n = _surfaceBank.size();
+    growWindBuffers(n);
+    for(i=0; i<n; i++)
+	_surfaceBank.getPosition(i, _windPos+3*i);
+    localWinds(n, _windPos, _windOut);
+    for(i=0; i<n; i++)
+        _surfaceBank.setWind(i, _windOut+3*i);
+    _surfaceBank.calcForces(_rho);
+
+    for(i=0; i<_surfaceBank.size(); i++) {
+	float force[3], torque[3], pos[3];
+	_surfaceBank.getPosition(i, pos);
+	_surfaceBank.getForce(i, force);
+	_surfaceBank.getTorque(i, torque);
+	Math::add3(faero, force, faero);
+
+	_body.addForce(pos, force);
+	_body.addTorque(torque);
+	RECORD_FORCE(_surfaceCats[i], pos, force);
+	RECORD_TORQUE(_surfaceCats[i], torque);
+    }
+}
+
 void Model::newState(State* s)
 {
     _s = s;
@@ -550,45 +883,117 @@ void Model::newState(State* s)
 	_crashed = true;
 }
 
+// Finds the parts of the local airflow that are the same at every
+// point for the given state: the rotation and velocity in local
+// coordinates, and the wind (less turbulence).  Must be called before
+// localWind() or localWinds() whenever the state changes.
+void Model::setWindFrame(State* s, float alt)
+{
+    _wfState = s;
+    _wfAlt = alt;
+    Math::vmul33(s->orient, _wind, _wfWind);
+    Math::vmul33(s->orient, s->rot, _wfRot);
+    Math::vmul33(s->orient, s->v, _wfV);
+}
+
 // Calculates the airflow direction at the given point and for the
-// specified aircraft velocity.
-void Model::localWind(float* pos, State* s, float* out, float alt, bool is_rotor)
+// aircraft velocity of the current wind frame.
+void Model::localWind(float* pos, float* out, bool is_rotor)
 {
-    float tmp[3], lwind[3], lrot[3], lv[3];
+    growWindBuffers(1);
+    localWinds(1, pos, out, is_rotor);
+}
 
-    // Get a global coordinate for our local position, and calculate
-    // turbulence.
+// The same for n points at once, three floats each, with the
+// turbulence sampled for all of them in one pass.
+void Model::localWinds(int n, float* pos, float* out, bool is_rotor)
+{
+    State* s = _wfState;
+    int i, j;
+
+    // Get a global coordinate for each local position, and calculate
+    // turbulence.  The wind is converted to local coordinates after
+    // the turbulence is added, as it always has been.
     if(_turb) {
-        double gpos[3]; float up[3];
-        Math::tmul33(s->orient, pos, tmp);
-        for(int i=0; i<3; i++) {
-            gpos[i] = s->pos[i] + tmp[i];
+        float* up = _windUp;
+        float* turb = _windTurb;
+        double* gpos = _windGPos;
+        for(i=0; i<n; i++) {
+            float tmp[3];
+            Math::tmul33(s->orient, pos+3*i, tmp);
+            for(j=0; j<3; j++)
+                gpos[3*i+j] = s->pos[j] + tmp[j];
+            Glue::geodUp(gpos+3*i, up+3*i);
+        }
+        _turb->getTurbulence(n, gpos, _wfAlt, up, turb);
+        for(i=0; i<n; i++) {
+            Math::add3(_wind, turb+3*i, turb+3*i);
+            Math::vmul33(s->orient, turb+3*i, turb+3*i);
         }
-        Glue::geodUp(gpos, up);
-        _turb->getTurbulence(gpos, alt, up, lwind);
-        Math::add3(_wind, lwind, lwind);
-    } else {
-        Math::set3(_wind, lwind);
     }
 
-    // Convert to local coordinates
-    Math::vmul33(s->orient, lwind, lwind);
-    Math::vmul33(s->orient, s->rot, lrot);
-    Math::vmul33(s->orient, s->v, lv);
+    for(i=0; i<n; i++) {
+        float* lwind = _turb ? _windTurb + 3*i : _wfWind;
+        float* o = out + 3*i;
 
-    _body.pointVelocity(pos, lrot, out); // rotational velocity
-    Math::mul3(-1, out, out);      //  (negated)
-    Math::add3(lwind, out, out);    //  + wind
-    Math::sub3(out, lv, out);       //  - velocity
+        _body.pointVelocity(pos+3*i, _wfRot, o); // rotational velocity
+        Math::mul3(-1, o, o);        //  (negated)
+        Math::add3(lwind, o, o);     //  + wind
+        Math::sub3(o, _wfV, o);      //  - velocity
 
-    //add the downwash of the rotors if it is not self a rotor
-    if (_rotorgear.isInUse()&&!is_rotor)
-    {
-        _rotorgear.getDownWash(pos,lv,tmp);
-        Math::add3(out,tmp, out);    //  + downwash
+        //add the downwash of the rotors if it is not self a rotor
+        if (_rotorgear.isInUse()&&!is_rotor)
+        {
+            float tmp[3];
+            _rotorgear.getDownWash(pos+3*i,_wfV,tmp);
+            Math::add3(o,tmp, o);    //  + downwash
+        }
     }
+}
 
+#ifdef YASIM_FORCE_BREAKDOWN
+// Adds a force at pos (or the c.g. if null) to the breakdown.
+void Model::recordForce(int category, float* pos, float* force)
+{
+    if(!_recordBreakdown)
+        return;
+    Math::add3(force, _breakdown.force[category],
+               _breakdown.force[category]);
+    if(pos) {
+        float cg[3], arm[3], moment[3];
+        _body.getCG(cg);
+        Math::sub3(pos, cg, arm);
+        Math::cross3(arm, force, moment);
+        Math::add3(moment, _breakdown.moment[category],
+                   _breakdown.moment[category]);
+    }
+}
+
+void Model::recordTorque(int category, float* torque)
+{
+    if(!_recordBreakdown)
+        return;
+    Math::add3(torque, _breakdown.moment[category],
+               _breakdown.moment[category]);
+}
+#endif
 
+// Makes room for n points in the localWinds() temporaries.
+void Model::growWindBuffers(int n)
+{
+    if(n <= _windBufSize)
+        return;
+    delete[] _windPos;
+    delete[] _windOut;
+    delete[] _windUp;
+    delete[] _windTurb;
+    delete[] _windGPos;
+    _windPos = new float[3*n];
+    _windOut = new float[3*n];
+    _windUp = new float[3*n];
+    _windTurb = new float[3*n];
+    _windGPos = new double[3*n];
+    _windBufSize = n;
 }
 
 }; // namespace yasim
@@ -7,6 +7,9 @@
 #include "Vector.hpp"
 #include "Turbulence.hpp"
 #include "Rotor.hpp"
+#include "SurfaceBank.hpp"
+#include "ThrusterBank.hpp"
+#include "ForceBreakdown.hpp"
 
 namespace yasim {
 
@@ -20,6 +23,9 @@ class Ground;
 class Hook;
 class Launchbar;
 class Hitch;
+class StateHash;
+class AeroDatabase;
+struct RotorWorkers;
 
 class Model : public BodyEnvironment {
 public:
@@ -30,6 +36,7 @@ public:
     Integrator* getIntegrator();
 
     void setTurbulence(Turbulence* turb) { _turb = turb; }
+    Turbulence* getTurbulence() { return _turb; }
 
     State* getState();
     void setState(State* s);
@@ -40,19 +47,47 @@ public:
 
     void iterate(float dt);
 
-    // Externally-managed subcomponents
+    // Adds the full body state, plus the internal state of the
+    // thrusters and rotors, to a digest.
+    void hashState(StateHash* h);
+
+    // Externally-managed subcomponents.  Surfaces are tagged with
+    // their ForceBreakdown category.
     int addThruster(Thruster* t);
-    int addSurface(Surface* surf);
+    int addSurface(Surface* surf, int category);
     int addGear(Gear* gear);
     void addHook(Hook* hook);
     void addLaunchbar(Launchbar* launchbar);
     Surface* getSurface(int handle);
+    int numSurfaces() { return _surfaces.size(); }
     Rotorgear* getRotorgear(void);
     Gear* getGear(int handle);
     Hook* getHook(void);
     int addHitch(Hitch* hitch);
     Launchbar* getLaunchbar(void);
 
+    // Evaluates the surfaces' stall and flap lift functions from
+    // lookup tables with the given resolution (intervals around the
+    // full circle of angle of attack), or analytically if zero.  Call
+    // only once the airplane is compiled.  Returns the largest error
+    // against the analytic path, as a fraction of a surface's Z force
+    // coefficient.
+    float setSurfaceTables(int resolution);
+
+    // Lets each type of thruster be integrated at its own rate rather
+    // than every step, its outputs held or extrapolated in between
+    // (ThrusterBank::DECIMATE_*).
+    void setThrusterDecimation(int mode) { _thrusterBank.setDecimation(mode); }
+
+    // Evaluates the rotorparts of all the rotors on n threads (this
+    // one and n-1 persistent workers), or serially, as always, if
+    // zero.  With any n, each part sees its neighbours' flapping
+    // angles as of the last call (Rotorpart::setDeferred()), and the
+    // forces are summed in the serial order, so the results are the
+    // same for every n > 0.  Call once the airplane is compiled.
+    void setRotorThreads(int n);
+    int getRotorThreads();
+
     // Semi-private methods for use by the Airplane solver.
     int numThrusters();
     Thruster* getThruster(int handle);
@@ -60,6 +95,25 @@ public:
     void initIteration(float dt);
     void getThrust(float* out);
 
+    // Adds just the aerodynamic force and torque of the surfaces to
+    // the body, and returns the total force.  Used by calcForces(),
+    // and by tools that tabulate the aerodynamics.
+    void calcAeroForces(State* s, float alt, float* faero);
+
+    // Replaces the surfaces with a table lookup in an AeroDatabase,
+    // or goes back to them with a null pointer.  The database is not
+    // owned by the Model.
+    void setAeroDatabase(AeroDatabase* db) { _aeroDb = db; }
+    AeroDatabase* getAeroDatabase() { return _aeroDb; }
+
+    // The forces and moments by component at the start of the last
+    // step, or null if not built with YASIM_FORCE_BREAKDOWN.
+#ifdef YASIM_FORCE_BREAKDOWN
+    ForceBreakdown* getForceBreakdown() { return &_breakdown; }
+#else
+    ForceBreakdown* getForceBreakdown() { return 0; }
+#endif
+
     void setGroundCallback(Ground* ground_cb);
     Ground* getGroundCallback(void);
 
@@ -80,8 +134,19 @@ private:
     void initRotorIteration(float dt);
     void calcGearForce(Gear* g, float* v, float* rot, float* ground);
     float gearFriction(float wgt, float v, Gear* g);
-    void localWind(float* pos, State* s, float* out, float alt,
-        bool is_rotor = false);
+    void calcRotorForces(State* s);
+    static void rotorWorker(RotorWorkers* w, int idx);
+    void runRotorparts(int n);
+    void stopRotorWorkers();
+    void sumAeroForces(float* faero);
+    void setWindFrame(State* s, float alt);
+    void localWind(float* pos, float* out, bool is_rotor = false);
+    void localWinds(int n, float* pos, float* out, bool is_rotor = false);
+    void growWindBuffers(int n);
+#ifdef YASIM_FORCE_BREAKDOWN
+    void recordForce(int category, float* pos, float* force);
+    void recordTorque(int category, float* torque);
+#endif
 
     Integrator _integrator;
     RigidBody _body;
@@ -90,6 +155,9 @@ private:
 
     Vector _thrusters;
     Vector _surfaces;
+    int* _surfaceCats; // ForceBreakdown category of each surface
+    SurfaceBank _surfaceBank;
+    AeroDatabase* _aeroDb;
     Rotorgear _rotorgear;
     Vector _gears;
     Hook* _hook;
@@ -107,10 +175,38 @@ private:
     float _rho;
     float _wind[3];
 
+    // The thrusters by type, and their outputs as of initIteration()
+    ThrusterBank _thrusterBank;
+
     // Accumulators for the total internal gyro and engine torque
     float _gyro[3];
     float _torque[3];
 
+    // The per-state part of the local airflow (see setWindFrame()),
+    // in local coordinates.
+    State* _wfState;
+    float _wfAlt;
+    float _wfWind[3];
+    float _wfRot[3];
+    float _wfV[3];
+
+    // Positions and airflows for localWinds(), and its turbulence
+    // temporaries, all three per point.
+    int _windBufSize;
+    float* _windPos;
+    float* _windOut;
+    float* _windUp;
+    float* _windTurb;
+    double* _windGPos;
+
+    // The rotor threads and their per-rotorpart buffers, or null
+    RotorWorkers* _rotorWorkers;
+
+#ifdef YASIM_FORCE_BREAKDOWN
+    ForceBreakdown _breakdown;
+    bool _recordBreakdown;
+#endif
+
     State* _s;
     bool _crashed;
     float _agl;
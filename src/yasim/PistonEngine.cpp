@@ -7,6 +7,62 @@ const static float HP2W = 745.7f;
 const static float CIN2CM = 1.6387064e-5f;
 const static float RPM2RADPS = 0.1047198f;
 
+// Calculate the factor required to modify supercharger output for
+// rpm. Assume that the normalized supercharger output ~= 1 when
+// the engine is at the nominal peak-power rpm.  A power equation
+// of the form (A * B^x * x^C) has been derived empirically from
+// some representative supercharger data.  This provides
+// near-linear output over the normal operating range, with
+// fall-off in the over-speed situation.
+static const float SC_A = 1.795206541;
+static const float SC_B = 0.55620178;
+static const float SC_C = 1.246708471;
+
+static float superchargerFactor(float rpm_norm)
+{
+    return SC_A * Math::fpow(SC_B, rpm_norm) * Math::fpow(rpm_norm, SC_C);
+}
+
+static float exactSuperchargerFactor(float rpm_norm)
+{
+    return SC_A * Math::pow(SC_B, rpm_norm) * Math::pow(rpm_norm, SC_C);
+}
+
+// The tables for setTables(): the supercharger factor by normalized
+// RPM up to 2, and (mp/p)^(2/7) by pressure ratio from 1/16 (its
+// slope is infinite at zero) up to 4.  Outside them calc() uses pow().
+static const int NTABLE = 512;
+static const float RPM_MAX = 2;
+static const float RATIO_MIN = 0.0625;
+static const float RATIO_MAX = 4;
+
+struct PistonTables {
+    float rpm[NTABLE+1];
+    float ratio[NTABLE+1];
+    PistonTables() {
+        float step = (RATIO_MAX - RATIO_MIN) / NTABLE;
+        for(int i=0; i<=NTABLE; i++) {
+            rpm[i] = exactSuperchargerFactor(i * (RPM_MAX/NTABLE));
+            ratio[i] = Math::pow(RATIO_MIN + i*step, 2.0/7.0);
+        }
+    }
+};
+
+static const PistonTables& tables()
+{
+    static PistonTables t;
+    return t;
+}
+
+static inline float lookup(const float* t, float x, float min, float max)
+{
+    float f = (x - min) * (NTABLE/(max - min));
+    int i = (int)f;
+    if(i >= NTABLE) i = NTABLE-1;
+    f -= i;
+    return t[i] + f*(t[i+1] - t[i]);
+}
+
 PistonEngine::PistonEngine(float power, float speed)
 {
     _boost = 1;
@@ -47,7 +103,9 @@ PistonEngine::PistonEngine(float power, float speed)
     // at about 2 cubic inches per horsepower or so, at least for
     // non-turbocharged engines.
     _compression = 8;
+    _egtCorr = 1.0f/(Math::pow(_compression, 0.4f) - 1.0f);
     _displacement = power * (2*CIN2CM/HP2W);
+    _tables = false;
 }
 
 void PistonEngine::setTurboParams(float turbo, float maxMP)
@@ -71,6 +129,7 @@ void PistonEngine::setDisplacement(float d)
 void PistonEngine::setCompression(float c)
 {
     _compression = c;
+    _egtCorr = 1.0f/(Math::pow(_compression, 0.4f) - 1.0f);
 }
 
 void PistonEngine::setMinThrottle(float m)
@@ -127,18 +186,12 @@ void PistonEngine::calc(float pressure, float temp, float speed)
 {
     _running = _magnetos && _fuel && (speed > 60*RPM2RADPS);
 
-    // Calculate the factor required to modify supercharger output for
-    // rpm. Assume that the normalized supercharger output ~= 1 when
-    // the engine is at the nominal peak-power rpm.  A power equation
-    // of the form (A * B^x * x^C) has been derived empirically from
-    // some representative supercharger data.  This provides
-    // near-linear output over the normal operating range, with
-    // fall-off in the over-speed situation.
     float rpm_norm = (speed / _omega0);
-    float A = 1.795206541;
-    float B = 0.55620178;
-    float C = 1.246708471;
-    float rpm_factor = A * Math::pow(B, rpm_norm) * Math::pow(rpm_norm, C);
+    float rpm_factor;
+    if(_tables && rpm_norm >= 0 && rpm_norm <= RPM_MAX)
+        rpm_factor = lookup(tables().rpm, rpm_norm, 0, RPM_MAX);
+    else
+        rpm_factor = superchargerFactor(rpm_norm);
     _chargeTarget = 1 + (_boost * (_turbo-1) * rpm_factor);
 
     if(_hasSuper) {
@@ -175,7 +228,12 @@ void PistonEngine::calc(float pressure, float temp, float speed)
     // pressure change can be assumed to be adiabatic.  Calculate a
     // temperature change, and use that to get the density.
     // Note: need to model intercoolers here...
-    float T = temp * Math::pow((_mp*_mp)/(pressure*pressure), 1.0/7.0);
+    float T;
+    float ratio = _mp/pressure;
+    if(_tables && ratio >= RATIO_MIN && ratio <= RATIO_MAX)
+        T = temp * lookup(tables().ratio, ratio, RATIO_MIN, RATIO_MAX);
+    else
+        T = temp * Math::fpow((_mp*_mp)/(pressure*pressure), 1.0/7.0);
     float rho = _mp / (287.1f * T);
 
     // The actual fuel flow is determined only by engine RPM and the
@@ -251,8 +309,7 @@ void PistonEngine::calc(float pressure, float temp, float speed)
     // 10% should do it.
     float massFlow = _fuelFlow + (rho * 0.5f * _displacement * speed);
     float specHeat = 1300;
-    float corr = 1.0f/(Math::pow(_compression, 0.4f) - 1.0f);
-    _egt = corr * (power * 1.1f) / (massFlow * specHeat);
+    _egt = _egtCorr * (power * 1.1f) / (massFlow * specHeat);
     if(_egt < temp) _egt = temp;
     
     
@@ -276,4 +333,42 @@ void PistonEngine::calc(float pressure, float temp, float speed)
     _dOilTempdt = (_oilTempTarget - _oilTemp) / tau;
 }
 
+float PistonEngine::getTableError()
+{
+    // Halfway between the points, where linear interpolation is worst
+    const PistonTables& t = tables();
+    float err[2] = { 0, 0 }, max[2] = { 0, 0 };
+    for(int i=0; i<NTABLE; i++) {
+        float x = (i + 0.5f) * (RPM_MAX/NTABLE);
+        float r = RATIO_MIN + (i + 0.5f) * ((RATIO_MAX-RATIO_MIN)/NTABLE);
+        float exact[2] = { exactSuperchargerFactor(x),
+                           Math::pow(r, 2.0/7.0) };
+        float table[2] = { lookup(t.rpm, x, 0, RPM_MAX),
+                           lookup(t.ratio, r, RATIO_MIN, RATIO_MAX) };
+        for(int j=0; j<2; j++) {
+            if(Math::abs(exact[j]) > max[j]) max[j] = Math::abs(exact[j]);
+            if(Math::abs(table[j] - exact[j]) > err[j])
+                err[j] = Math::abs(table[j] - exact[j]);
+        }
+    }
+    float e0 = err[0] / max[0], e1 = err[1] / max[1];
+    return e0 > e1 ? e0 : e1;
+}
+
+void PistonEngine::hashState(StateHash* h)
+{
+    Engine::hashState(h);
+    h->add(_charge);
+    h->add(_chargeTarget);
+    h->add(_wastegate);
+    h->add(_mp);
+    h->add(_torque);
+    h->add(_fuelFlow);
+    h->add(_egt);
+    h->add(_boostPressure);
+    h->add(_oilTemp);
+    h->add(_oilTempTarget);
+    h->add(_dOilTempdt);
+}
+
 }; // namespace yasim
@@ -8,6 +8,7 @@ namespace yasim {
 class PistonEngine : public Engine {
 public:
     virtual PistonEngine* isPistonEngine() { return this; }
+    virtual Engine* clone() { return new PistonEngine(*this); }
 
     // Initializes an engine from known "takeoff" parameters.
     PistonEngine(float power, float spd);
@@ -19,6 +20,14 @@ public:
     void setSupercharger(bool hasSuper) { _hasSuper = hasSuper; }
     void setTurboLag(float lag) { _turboLag = lag; }
 
+    // Takes the supercharger's RPM factor and the manifold's adiabatic
+    // temperature rise from tables shared by all engines, rather than
+    // from pow(), over the range an engine normally sees.
+    // getTableError() is the largest error of the tables, as a
+    // fraction of the largest value in them.
+    void setTables(bool tables) { _tables = tables; }
+    static float getTableError();
+
     bool isCranking();
     float getMP();
     float getEGT();
@@ -31,6 +40,9 @@ public:
     virtual void integrate(float dt);
     virtual float getTorque();
     virtual float getFuelFlow();
+    virtual void hashState(StateHash* h);
+    virtual void hashControls(StateHash* h) {
+        Engine::hashControls(h); h->add(_wastegate); }
 
 private:
     // Static configuration:
@@ -49,6 +61,8 @@ private:
     float _displacement; // piston stroke volume
     float _compression;  // compression ratio (>1)
     float _minthrottle; // minimum throttle [0:1]
+    float _egtCorr;  // from the compression ratio
+    bool _tables;
 
     // Runtime state/output:
     float _mp;
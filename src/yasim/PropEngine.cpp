@@ -1,6 +1,7 @@
 #include "Math.hpp"
 #include "Propeller.hpp"
 #include "Engine.hpp"
+#include "StateHash.hpp"
 #include "PropEngine.hpp"
 namespace yasim {
 
@@ -18,6 +19,8 @@ PropEngine::PropEngine(Propeller* prop, Engine* eng, float moment)
     _moment = moment;
     _fuel = true;
     _contra = false;
+    _numBalances = 0;
+    _nextBalance = 0;
 }
 
 PropEngine::~PropEngine()
@@ -26,6 +29,14 @@ PropEngine::~PropEngine()
     delete _eng;
 }
 
+PropEngine* PropEngine::clone()
+{
+    PropEngine* p = new PropEngine(*this);
+    p->_prop = _prop->clone();
+    p->_eng = _eng->clone();
+    return p;
+}
+
 void PropEngine::setMagnetos(int pos)
 {
     _magnetos = pos;
@@ -98,6 +109,126 @@ float PropEngine::getFuelFlow()
     return _fuelFlow;
 }
 
+// The engine's torque less the propeller's, as a rotational
+// acceleration, at an omega or (for a variable propeller) a pitch.
+// Leaves the engine and the thrust as they are there.
+float PropEngine::balance(float speed, float x)
+{
+    if(_variable) _prop->setPitch(x);
+    else          _omega = x;
+
+    float ptau, thrust;
+    _prop->calc(_rho, speed, _omega * _gearRatio, &thrust, &ptau);
+    _eng->calc(_pressure, _temp, _omega);
+    _eng->stabilize();
+
+    // Do it again -- the turbo sets the target MP in the first
+    // run, stabilize sets the current to the target, then we need
+    // to run again to get the correct output torque.  Clumsy, but
+    // it works without side effects (other than solver
+    // performance).  In the future, the Engine objects should
+    // store state to allow them to do the work themselves.
+    _eng->calc(_pressure, _temp, _omega);
+
+    // Compute torque as seen by the engine's end of the gearbox.
+    // The propeller will be moving more slowly (for gear ratios
+    // less than one), so it's torque will be higher than the
+    // engine's, so multiply by _gearRatio to get the engine-side
+    // value.
+    ptau *= _gearRatio;
+    float etau = _eng->getTorque();
+    Math::mul3(thrust, _dir, _thrust);
+    return (etau - ptau) / Math::abs(_moment * _gearRatio);
+}
+
+// Brackets the balance and closes in on it.  The balance falls as
+// omega or the pitch goes up.  If there's none to be had, this is the
+// end of the range nearest to one.
+float PropEngine::findBalance(float speed)
+{
+    const int MAXBRACKET = 8;
+    float a, b, fa, fb;
+    int i;
+    if(_variable) {
+        a = _prop->getFineStop();
+        b = _prop->getCoarseStop();
+        fa = balance(speed, a);
+        fb = balance(speed, b);
+    } else {
+        // Start off at 500rpm, doubling or halving from there
+        a = b = 52;
+        fa = fb = balance(speed, a);
+        for(i=0; i<MAXBRACKET && fb > 0; i++) {
+            a = b; fa = fb;
+            b *= 2; fb = balance(speed, b);
+        }
+        for(i=0; i<MAXBRACKET && fa < 0; i++) {
+            b = a; fb = fa;
+            a *= 0.5f; fa = balance(speed, a);
+        }
+    }
+    if((fa > 0) == (fb > 0))
+        return Math::abs(fa) < Math::abs(fb) ? a : b;
+    return solveBalance(speed, a, fa, b, fb);
+}
+
+// Brent's method: inverse quadratic interpolation or the secant where
+// they behave, bisection where they don't.  a and b bracket the root.
+float PropEngine::solveBalance(float speed, float a, float fa,
+                               float b, float fb)
+{
+    const int MAXITER = 50;
+    const float XTOL = 1e-5f;  // relative
+    const float FTOL = 1e-3f;  // rad/s^2
+    float c = b, fc = fb, d = b - a, e = d;
+    for(int n=0; n<MAXITER; n++) {
+        if((fb > 0) == (fc > 0)) {
+            c = a; fc = fa;
+            d = e = b - a;
+        }
+        if(Math::abs(fc) < Math::abs(fb)) {
+            a = b; b = c; c = a;
+            fa = fb; fb = fc; fc = fa;
+        }
+        float tol = XTOL * Math::abs(b);
+        float m = 0.5f * (c - b);
+        if(Math::abs(m) <= tol || Math::abs(fb) < FTOL)
+            break;
+        if(Math::abs(e) >= tol && Math::abs(fa) > Math::abs(fb)) {
+            float s = fb/fa, p, q;
+            if(a == c) {
+                p = 2*m*s;
+                q = 1 - s;
+            } else {
+                float r = fb/fc;
+                q = fa/fc;
+                p = s*(2*m*q*(q - r) - (b - a)*(r - 1));
+                q = (q - 1)*(r - 1)*(s - 1);
+            }
+            if(p > 0) q = -q;
+            else      p = -p;
+            float min1 = 3*m*q - Math::abs(tol*q), min2 = Math::abs(e*q);
+            if(2*p < (min1 < min2 ? min1 : min2)) {
+                e = d; d = p/q;
+            } else {
+                d = m; e = m;
+            }
+        } else {
+            d = m; e = m;
+        }
+        a = b; fa = fb;
+        if(Math::abs(d) > tol) b += d;
+        else                   b += m > 0 ? tol : -tol;
+        fb = balance(speed, b);
+    }
+    return b;
+}
+
+// Finds the omega (or the pitch, for a variable propeller) at which
+// the engine's torque balances the propeller's.  The solver asks for
+// the same cruise and approach conditions on every iteration, so the
+// last few answers are kept; the engine and propeller are left the
+// same either way.
 void PropEngine::stabilize()
 {
     float speed = -Math::dot3(_wind, _dir);
@@ -110,57 +241,30 @@ void PropEngine::stabilize()
     bool running_state = _eng->isRunning();
     _eng->setRunning(true);
 
-    if(_variable) {
+    if(_variable)
 	_omega = _minOmega + _advance * (_maxOmega - _minOmega);
-	_prop->modPitch(1e6); // Start at maximum pitch and move down
-    } else {
-	_omega = 52;
-    }
 
-    bool goingUp = false;
-    float step = 10;
-
-    // If we cannot manage this in 100 iterations, give up.
-    for (int n = 0; n < 100; n++) {
-	float ptau, thrust;
-	_prop->calc(_rho, speed, _omega * _gearRatio, &thrust, &ptau);
-	_eng->calc(_pressure, _temp, _omega);
-        _eng->stabilize();
-
-        // Do it again -- the turbo sets the target MP in the first
-        // run, stabilize sets the current to the target, then we need
-        // to run again to get the correct output torque.  Clumsy, but
-        // it works without side effects (other than solver
-        // performance).  In the future, the Engine objects should
-        // store state to allow them to do the work themselves.
-	_eng->calc(_pressure, _temp, _omega);
-
-        // Compute torque as seen by the engine's end of the gearbox.
-        // The propeller will be moving more slowly (for gear ratios
-        // less than one), so it's torque will be higher than the
-        // engine's, so multiply by _gearRatio to get the engine-side
-        // value.
-        ptau *= _gearRatio;
-        float etau = _eng->getTorque();
-	float tdiff = etau - ptau;
-        
-        Math::mul3(thrust, _dir, _thrust);
-
-	if(Math::abs(tdiff/(_moment * _gearRatio)) < 0.1)
-	    break;
-
-	if(tdiff > 0) {
-	    if(!goingUp) step *= 0.5f;
-	    goingUp = true;
- 	    if(!_variable)  _omega += step;
-	    else            _prop->modPitch(1+(step*0.005f));
-	} else {
-	    if(goingUp) step *= 0.5f;
-	    goingUp = false;
- 	    if(!_variable)  _omega -= step;
-	    else            _prop->modPitch(1-(step*0.005f));
-	}
+    StateHash h;
+    h.add(_rho); h.add(speed); h.add(_pressure); h.add(_temp);
+    // A fixed propeller's omega is what's being solved for, left over
+    // from the last call; a variable one's is the governed target.
+    if(_variable) h.add(_omega);
+    _eng->hashControls(&h);
+    _prop->hashControls(&h);
+    uint64_t key = h.get();
+
+    int i;
+    for(i=0; i<_numBalances; i++)
+        if(_balances[i].key == key)
+            break;
+    if(i == _numBalances) {
+        i = _nextBalance;
+        _nextBalance = (_nextBalance + 1) % NBALANCES;
+        if(_numBalances < NBALANCES) _numBalances++;
+        _balances[i].key = key;
+        _balances[i].x = findBalance(speed);
     }
+    balance(speed, _balances[i].x);
 
     // ...and back off
     _eng->setRunning(running_state);
@@ -248,4 +352,18 @@ void PropEngine::integrate(float dt)
     }
 }
 
+void PropEngine::hashState(StateHash* h)
+{
+    Thruster::hashState(h);
+    h->add(_magnetos);
+    h->add(_advance);
+    h->add(_omega);
+    h->add(_thrust, 3);
+    h->add(_torque, 3);
+    h->add(_gyro, 3);
+    h->add(_fuelFlow);
+    _prop->hashState(h);
+    _eng->hashState(h);
+}
+
 }; // namespace yasim
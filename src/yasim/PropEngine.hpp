@@ -13,6 +13,10 @@ public:
     PropEngine(Propeller* prop, Engine* eng, float moment);
     virtual ~PropEngine();
 
+    // A copy with its own propeller and engine, in the same state, to
+    // run independently of this one.
+    PropEngine* clone();
+
     void setEngine(Engine* eng) { delete _eng; _eng = eng; }
 
     void setMagnetos(int magnetos);
@@ -39,11 +43,20 @@ public:
     virtual void init();
     virtual void integrate(float dt);
     virtual void stabilize();
+    virtual void hashState(StateHash* h);
+
+    // The propeller speed is Euler-integrated; YASim has always run
+    // at 120Hz in FlightGear.
+    virtual float getUpdateRate() { return 120; }
 
     float getOmega();
     void setOmega (float omega);
     
 private:
+    float balance(float speed, float x);
+    float findBalance(float speed);
+    float solveBalance(float speed, float a, float fa, float b, float fb);
+
     float _moment;
     Propeller* _prop;
     Engine* _eng;
@@ -61,6 +74,14 @@ private:
     float _torque[3];
     float _gyro[3];
     float _fuelFlow;
+
+    // The last few balances stabilize() found: omega, or the pitch for
+    // a variable propeller, by a digest of the conditions.
+    struct Balance { uint64_t key; float x; };
+    enum { NBALANCES = 4 };
+    Balance _balances[NBALANCES];
+    int _numBalances;
+    int _nextBalance;
 };
 
 }; // namespace yasim
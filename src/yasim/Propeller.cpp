@@ -2,6 +2,7 @@
 
 #include "Atmosphere.hpp"
 #include "Math.hpp"
+#include "StateHash.hpp"
 #include "Propeller.hpp"
 namespace yasim {
 
@@ -25,6 +26,25 @@ Propeller::Propeller(float radius, float v, float omega,
     _manual = false;
     _proppitch = 0;
     _propfeather = 0;
+    _table = 0;
+    _tableRes = 0;
+    _tableSize = 0;
+}
+
+Propeller::~Propeller()
+{
+    delete[] _table;
+}
+
+Propeller* Propeller::clone()
+{
+    Propeller* p = new Propeller(*this);
+    if(_table) {
+        p->_table = new float[2*_tableSize];
+        for(int i=0; i<2*_tableSize; i++)
+            p->_table[i] = _table[i];
+    }
+    return p;
 }
 
 void Propeller::setTakeoff(float omega0, float power0)
@@ -46,20 +66,34 @@ void Propeller::setStops(float fine_stop, float coarse_stop)
     
 void Propeller::modPitch(float mod)
 {
+    if(_manual) return;
     _j0 *= mod;
     if(_j0 < _fine_stop*_baseJ0) _j0 = _fine_stop*_baseJ0;
     if(_j0 > _coarse_stop*_baseJ0)     _j0 = _coarse_stop*_baseJ0;
 }
 
+void Propeller::setPitch(float pitch)
+{
+    if(_manual) return;
+    _j0 = _baseJ0 * Math::clamp(pitch, _fine_stop, _coarse_stop);
+}
+
+// For manual pitch, exponentially modulate the J0 value between
+// 0.25 and 4.  A prop pitch of 0.5 results in no change from the
+// base value.
+// TODO: integrate with _fine_stop and _coarse_stop variables
 void Propeller::setManualPitch()
 {
     _manual = true;
+    _j0 = _baseJ0 * Math::pow(2, 2 - 4*_proppitch);
 }
 
 void Propeller::setPropPitch(float proppitch)
 {
     // makes only positive range of axis effective.
     _proppitch = Math::clamp(proppitch, 0, 1);
+    if (_manual)
+        _j0 = _baseJ0 * Math::pow(2, 2 - 4*_proppitch);
 }
 
 void Propeller::setPropFeather(int state)
@@ -71,13 +105,6 @@ void Propeller::setPropFeather(int state)
 void Propeller::calc(float density, float v, float omega,
 		     float* thrustOut, float* torqueOut)
 {
-    // For manual pitch, exponentially modulate the J0 value between
-    // 0.25 and 4.  A prop pitch of 0.5 results in no change from the
-    // base value.
-    // TODO: integrate with _fine_stop and _coarse_stop variables
-    if (_manual) 
-        _j0 = _baseJ0 * Math::pow(2, 2 - 4*_proppitch);
-    
     float tipspd = _r*omega;
     float V2 = v*v + tipspd*tipspd;
 
@@ -85,6 +112,15 @@ void Propeller::calc(float density, float v, float omega,
     if(v < 0) v = 0;
     if(omega < 0.001) omega = 0.001;
 
+    if(_table) {
+        float ct, cq;
+        lookupCoefs(v / (omega * _j0), &ct, &cq);
+        float q = 0.5f * density * V2 * _f0;
+        *thrustOut = q * ct;
+        *torqueOut = q * _j0 * cq;
+        return;
+    }
+
     float J = v/omega;    // Advance ratio
     float lambda = J/_j0; // Unitless scalar advance ratio
 
@@ -119,4 +155,85 @@ void Propeller::calc(float density, float v, float omega,
     *torqueOut = torque;
 }
 
+// calc()'s thrust and torque without the dynamic pressure and pitch
+// scaling: thrust is 0.5*density*V2*_f0*ct, and torque that times
+// _j0*cq.  The torque is simplified to have no singularity at
+// lambda == 1.
+void Propeller::calcCoefs(float lambda, float* ct, float* cq)
+{
+    float k = 1 / (_etaC * _beta * (1 - _lambdaPeak));
+    float tc = (1 - lambda) / (1 - _lambdaPeak);
+    if(lambda > 1) {
+        float lambdaWM = 1.2f;
+        *ct = tc;
+        *cq = 0.25f * k * (1 - (lambda - 1) / (lambdaWM - 1));
+    } else if(_matchTakeoff && tc > _tc0) {
+        float l4 = lambda*lambda; l4 = l4*l4;
+        *ct = _tc0;
+        *cq = _tc0 / (_etaC * _beta * (1 - l4));
+    } else {
+        *ct = tc;
+        *cq = k / ((1 + lambda) * (1 + lambda*lambda));
+    }
+}
+
+void Propeller::lookupCoefs(float lambda, float* ct, float* cq)
+{
+    float x = lambda * _tableRes;
+    int i = (int)x;
+    if(i > _tableSize-2) i = _tableSize-2;
+    float f = x - i;
+    float* t = _table + 2*i;
+    *ct = t[0] + f*(t[2] - t[0]);
+    *cq = t[1] + f*(t[3] - t[1]);
+}
+
+float Propeller::setTable(int resolution)
+{
+    delete[] _table;
+    _table = 0;
+    if(resolution <= 0)
+        return 0;
+
+    // Up to lambda 2.  Both curves are straight lines past 1, so the
+    // last interval extends past it exactly.
+    _tableRes = resolution;
+    _tableSize = 2*resolution + 1;
+    _table = new float[2*_tableSize];
+    int i;
+    for(i=0; i<_tableSize; i++)
+        calcCoefs(i / (float)resolution, &_table[2*i], &_table[2*i+1]);
+
+    // Check between the points
+    const int SUB = 16;
+    float err[2] = { 0, 0 }, max[2] = { 0, 0 };
+    for(i=0; i<SUB*(_tableSize-1); i++) {
+        float lambda = (i + 0.5f) / (SUB * resolution);
+        float c[2], t[2];
+        calcCoefs(lambda, &c[0], &c[1]);
+        lookupCoefs(lambda, &t[0], &t[1]);
+        for(int k=0; k<2; k++) {
+            if(Math::abs(c[k]) > max[k]) max[k] = Math::abs(c[k]);
+            if(Math::abs(t[k] - c[k]) > err[k]) err[k] = Math::abs(t[k] - c[k]);
+        }
+    }
+    float e0 = err[0] / max[0], e1 = err[1] / max[1];
+    return e0 > e1 ? e0 : e1;
+}
+
+void Propeller::hashState(StateHash* h)
+{
+    h->add(_j0);
+    h->add(_f0);
+    h->add(_manual);
+    h->add(_proppitch);
+    h->add(_propfeather);
+}
+
+void Propeller::hashControls(StateHash* h)
+{
+    h->add(_manual);
+    h->add(_proppitch);
+}
+
 }; // namespace yasim
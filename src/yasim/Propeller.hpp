@@ -3,6 +3,8 @@
 
 namespace yasim {
 
+class StateHash;
+
 // A generic propeller model.  See the TeX documentation for
 // implementation details, this is too hairy to explain in code
 // comments.
@@ -15,6 +17,10 @@ public:
     // zero and sea level).  RPM values are in radians per second, of
     // course.
     Propeller(float radius, float v, float omega, float rho, float power);
+    ~Propeller();
+
+    // A new propeller the same as this one, table and all.
+    Propeller* clone();
 
     void setStops (float fine_stop, float coarse_stop);
 
@@ -22,6 +28,12 @@ public:
 
     void modPitch(float mod);
 
+    // Sets the pitch as a multiple of the cruise pitch, clamped to the
+    // stops.
+    void setPitch(float pitch);
+    float getFineStop() { return _fine_stop; }
+    float getCoarseStop() { return _coarse_stop; }
+
     void setPropPitch(float proppitch);
 
     void setPropFeather(int state);
@@ -31,7 +43,24 @@ public:
     void calc(float density, float v, float omega,
 	      float* thrustOut, float* torqueOut);
 
+    // Looks the thrust and torque up in a table over the scalar
+    // advance ratio (J/J0, which is all they depend on once scaled by
+    // the pitch and dynamic pressure) with the given resolution
+    // (intervals per unit), or computes them analytically if zero.
+    // Returns the largest error against the analytic curves, as a
+    // fraction of the largest thrust or torque coefficient.
+    float setTable(int resolution);
+
+    // Adds the runtime state to a digest, for the deterministic mode.
+    void hashState(StateHash* h);
+
+    // Adds just the pitch controls, which calc() depends on.
+    void hashControls(StateHash* h);
+
 private:
+    void calcCoefs(float lambda, float* ct, float* cq);
+    void lookupCoefs(float lambda, float* ct, float* cq);
+
     float _r;           // characteristic radius
     float _j0;          // zero-thrust advance ratio
     float _baseJ0;      //  ... uncorrected for prop advance
@@ -46,6 +75,9 @@ private:
     bool  _manual;      // manual pitch mode
     float _proppitch;   // prop pitch control setting (0 ~ 1.0)
     float _propfeather; // prop feather control setting (0 = norm, 1 = feather)
+    float* _table;      // thrust and torque coefficient pairs, or null
+    int _tableRes;      // table intervals per unit of lambda
+    int _tableSize;     // entries in the table
 };
 
 }; // namespace yasim
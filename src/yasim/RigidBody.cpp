@@ -158,6 +158,16 @@ void RigidBody::getCG(float* cgOut)
     Math::set3(_cg, cgOut);
 }
 
+void RigidBody::getForce(float* forceOut)
+{
+    Math::set3(_force, forceOut);
+}
+
+void RigidBody::getTorque(float* torqueOut)
+{
+    Math::set3(_torque, torqueOut);
+}
+
 void RigidBody::getAccel(float* accelOut)
 {
     Math::mul3(1/_totalMass, _force, accelOut);
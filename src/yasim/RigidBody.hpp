@@ -84,6 +84,11 @@ public:
     // coordinate system.
     void getCG(float* cgOut);
 
+    // The force and the torque (about the c.g.) accumulated since
+    // the last reset(), in local coordinates.
+    void getForce(float* forceOut);
+    void getTorque(float* torqueOut);
+
     // Returns the acceleration of the body's c.g. relative to the
     // rest of the world, specified in local coordinates.
     void getAccel(float* accelOut);
@@ -11,6 +11,7 @@
 #include "Rotorpart.hpp"
 #include "Glue.hpp"
 #include "Ground.hpp"
+#include "StateHash.hpp"
 #include "Rotor.hpp"
 
 #include <iostream>
@@ -252,7 +253,7 @@ float Rotor::getLiftCoef(float incidence,float speed)
     float c1=  (i2-_airfoil_incidence_no_lift)*_liftcoef;
     if (stall > 0)
     {
-    float c2=  Math::sin(2*(incidence-_airfoil_incidence_no_lift))
+    float c2=  Math::fsin(2*(incidence-_airfoil_incidence_no_lift))
         *_liftcoef*_lift_factor_stall;
     return (1-stall)*c1 + stall *c2;
     }
@@ -263,12 +264,81 @@ float Rotor::getLiftCoef(float incidence,float speed)
 float Rotor::getDragCoef(float incidence,float speed)
 {
     float stall=calcStall(incidence,speed);
-    float c1= (Math::abs(Math::sin(incidence-_airfoil_incidence_no_lift))
+    float c1= (Math::abs(Math::fsin(incidence-_airfoil_incidence_no_lift))
         *_dragcoef1+_dragcoef0);
     float c2= c1*_drag_factor_stall;
     return (1-stall)*c1 + stall *c2;
 }
 
+// getLiftCoef() (at incidenceWoCyc and at incidence) and getDragCoef()
+// (at incidence) for the first n segments of a block, with the
+// build's math tier.  Each of the three counts in the stall average,
+// as the single calls do.
+void Rotor::getSegmentCoefs(int n, SegmentBlock* b, float* sums)
+{
+    getSegmentCoefsT<Math::TIER>(n,b);
+
+    // Summed apart, in order, so that the loop above has no reduction
+    float* s0=sums?&sums[0]:&_stall_sum;
+    float* s1=sums?&sums[1]:&_stall_v2sum;
+    for (int i=0;i<n;i++)
+    {
+        *s0+=b->stall[i];
+        *s1+=3*b->speed[i]*b->speed[i];
+    }
+}
+
+// The arithmetic of calcStall(), getLiftCoef() and getDragCoef(),
+// with selects for the branches, so the loop can be vectorized.
+static inline float segmentStall(float incidence,float stall_incidence,
+    float change_over)
+{
+    float a=Math::abs(incidence);
+    a=a>pi/2?pi-a:a;
+    return Math::clamp((a-stall_incidence)/change_over,0,1);
+}
+
+template<int T> void Rotor::getSegmentCoefsT(int n, SegmentBlock* b)
+{
+    // In locals, as the stores below might alias the members
+    float stall0=_incidence_stall_zero_speed;
+    float dstall=(_incidence_stall_half_sonic_speed
+        -_incidence_stall_zero_speed)/(343./2);
+    float change_over=_stall_change_over;
+    float a0=_airfoil_incidence_no_lift;
+    float cl=_liftcoef, cl_stall=_liftcoef*_lift_factor_stall;
+    float cd0=_dragcoef0, cd1=_dragcoef1, cd_stall=_drag_factor_stall;
+    for (int i=0;i<n;i++)
+    {
+        float wo=b->incidenceWoCyc[i],inc=b->incidence[i];
+        float v2=b->speed[i]*b->speed[i];
+        float stall_incidence=stall0+dstall*b->speed[i];
+        float stall_wo=segmentStall(wo,stall_incidence,change_over);
+        float stall=segmentStall(inc,stall_incidence,change_over);
+
+        float s_wo=FastMath::sinNear<T>(2*(wo-a0));
+        float s2=FastMath::sinNear<T>(2*(inc-a0));
+        float s1=FastMath::sinNear<T>(inc-a0);
+
+        float i2=wo>pi/2?wo-pi:(wo<-pi/2?wo+pi:wo);
+        float c1=(i2-a0)*cl;
+        float c2=s_wo*cl_stall;
+        b->liftWoCyc[i]=(1-stall_wo)*c1+stall_wo*c2;
+
+        i2=inc>pi/2?inc-pi:(inc<-pi/2?inc+pi:inc);
+        c1=(i2-a0)*cl;
+        c2=s2*cl_stall;
+        b->lift[i]=(1-stall)*c1+stall*c2;
+
+        c1=Math::abs(s1)*cd1+cd0;
+        c2=c1*cd_stall;
+        b->drag[i]=(1-stall)*c1+stall*c2;
+
+        // The lift and the drag at incidence both count
+        b->stall[i]=(stall_wo+2*stall)*v2;
+    }
+}
+
 int Rotor::getValueforFGSet(int j,char *text,float *f)
 {
     if (_name[0]==0) return 0;
@@ -827,7 +897,7 @@ void Rotor::calcLiftFactor(float* v, float rho, State *s)
     float help[3];
     Math::cross3(v,_normal,help);
     float v_horiz = Math::mag3(help);
-    _f_tl = ((1-Math::pow(2.7183,-v_horiz/_translift_ve))
+    _f_tl = ((1-Math::fpow(2.7183,-v_horiz/_translift_ve))
         *(_translift_maxfactor-1)+1)/_translift_maxfactor;
 
     _lift_factor = _f_ge*_f_tl*_f_vs;
@@ -981,7 +1051,7 @@ void Rotor::getDownWash(float *pos, float *v_heli, float *downwash)
     }
 
     //calculate the mean downwash speed directly beneath the rotor disk
-    float v1bar = Math::sin(inc) *_omega * 0.35 * _diameter * 0.8; 
+    float v1bar = Math::fsin(inc) *_omega * 0.35 * _diameter * 0.8; 
     //0.35 * d = 0.7 *r, a good position to calcualte the mean downwashd
     //0.8 the slip of the rotor.
 
@@ -1019,7 +1089,7 @@ void Rotor::getDownWash(float *pos, float *v_heli, float *downwash)
     //calculate the downwash speed directly beneath the rotor disk
     float v1=0;
     if (rel_r<1)
-        v1 = Math::sin(inc_r) *_omega * r * 0.8; 
+        v1 = Math::fsin(inc_r) *_omega * r * 0.8; 
 
     //calcualte the downwash speed in a distance "dist" to the rotor disc,
     //for large dist. The speed is assumed do follow a gausian distribution 
@@ -1029,11 +1099,11 @@ void Rotor::getDownWash(float *pos, float *v_heli, float *downwash)
 
     float sigma=_diameter/2 + dist * dist / _diameter /4.;
     float v2 = v1bar*_diameter/ (Math::sqrt(2 * pi) * sigma) 
-        * Math::pow(2.7183,-.5*r*r/(sigma*sigma))*_diameter/2/sigma;
+        * Math::fpow(2.7183,-.5*r*r/(sigma*sigma))*_diameter/2/sigma;
 
     //calculate the weight of the two downwash velocities.
     //Directly beneath the disc it is v1, far away it is v2
-    float g = Math::pow(2.7183,-2*dist/_diameter); 
+    float g = Math::fpow(2.7183,-2*dist/_diameter); 
     //at dist = rotor radius it is assumed to be 1/e * v1 + (1-1/e)* v2
 
     float v = g * v1 + (1-g) * v2;
@@ -1693,4 +1763,42 @@ Rotorgear::~Rotorgear()
         delete (Rotor*)_rotors.get(i);
 }
 
+void Rotor::hashState(StateHash* h)
+{
+    h->add(_torque);
+    h->add(_omega);
+    h->add(_omegan);
+    h->add(_omegarel);
+    h->add(_ddt_omega);
+    h->add(_omegarelneu);
+    h->add(_collective);
+    h->add(_cyclicail);
+    h->add(_cyclicele);
+    h->add(_tilt_yaw);
+    h->add(_tilt_roll);
+    h->add(_tilt_pitch);
+    h->add(_lift_factor);
+    h->add(_f_ge);
+    h->add(_f_vs);
+    h->add(_f_tl);
+    h->add(_vortex_state);
+    h->add(_stall_sum);
+    h->add(_stall_v2sum);
+    h->add(_phi);
+    for(int i=0; i<_rotorparts.size(); i++)
+        ((Rotorpart*)_rotorparts.get(i))->hashState(h);
+}
+
+void Rotorgear::hashState(StateHash* h)
+{
+    h->add(_engineon);
+    h->add(_rotorbrake);
+    h->add(_ddt_omegarel);
+    h->add(_total_torque_on_engine);
+    h->add(_target_rel_rpm);
+    h->add(_max_rel_torque);
+    for(int i=0; i<_rotors.size(); i++)
+        ((Rotor*)_rotors.get(i))->hashState(h);
+}
+
 }; // namespace yasim
@@ -110,6 +110,7 @@ public:
     void getDownWash(float *pos, float * v_heli, float *downwash);
     int getNumberOfBlades(){return _number_of_blades;}
     void setDownwashFactor(float value);
+    void hashState(StateHash* h);
 
     // Query the list of Rotorpart objects
     int numRotorparts();
@@ -127,6 +128,27 @@ public:
     float getLiftFactor();
     float getLiftCoef(float incidence,float speed);
     float getDragCoef(float incidence,float speed);
+    // Brings in the stall that getSegmentCoefs() summed apart.
+    void addStall(float* stall)
+        {_stall_sum+=stall[0];_stall_v2sum+=stall[1];}
+
+    // A block of blade segments for getSegmentCoefs(), a fixed size
+    // array per field (see Rotorpart::calculateAlpha()).
+    struct SegmentBlock {
+        enum { SIZE = 8 };
+        float incidenceWoCyc[SIZE]; // in
+        float incidence[SIZE];
+        float speed[SIZE];
+        float liftWoCyc[SIZE];      // out
+        float lift[SIZE];
+        float drag[SIZE];
+        float stall[SIZE];          // scratch
+    };
+    // The segments' stall counts in getOverallStall(), or, given
+    // stall, is added to stall[0] (weighted) and stall[1] (weights)
+    // for addStall() to bring in later.
+    void getSegmentCoefs(int n, SegmentBlock* b, float* stall=0);
+
     float getOmegaRel() {return _omegarel;}
     float getOmegaRelNeu() {return _omegarelneu;}
     void setOmegaRelNeu(float orn) {_omegarelneu=orn;}
@@ -150,6 +172,7 @@ private:
     void strncpy(char *dest,const char *src,int maxlen);
     void interp(float* v1, float* v2, float frac, float* out);
     float calcStall(float incidence,float speed);
+    template<int T> void getSegmentCoefsT(int n, SegmentBlock* b);
     float findGroundEffectAltitude(Ground * ground_cb,State *s,
         float *pos0,float *pos1,float *pos2,float *pos3,
         int iteration=0,float a0=-1,float a1=-1,float a2=-1,float a3=-1);
@@ -289,6 +312,7 @@ public:
     void initRotorIteration(float *lrot,float dt);
     void getDownWash(float *pos, float * v_heli, float *downwash);
     int getValueforFGSet(int j,char *b,float *f);
+    void hashState(StateHash* h);
 };
 
 }; // namespace yasim
@@ -3,6 +3,7 @@
 #include <simgear/debug/logstream.hxx>
 
 #include "Math.hpp"
+#include "StateHash.hpp"
 #include "Rotorpart.hpp"
 #include "Rotor.hpp"
 #include <stdio.h>
@@ -35,6 +36,9 @@ Rotorpart::Rotorpart()
     _mass=10;
     _incidence = 0;
     _alpha=0;
+    _deferred=false;
+    _deferred_alpha=0;
+    _stall[0]=_stall[1]=0;
     _alphamin=-.1;
     _alphamax= .1;
     _alpha0=-.05;
@@ -79,11 +83,11 @@ void Rotorpart::inititeration(float dt,float *rot)
     while (_phi<(0   )) _phi+=2*pi;
     float a=Math::dot3(rot,_normal);
     if(a>0)
-        _alphaalt=_alpha*Math::cos(a)
-        +_next90rp->getrealAlpha()*Math::sin(a);
+        _alphaalt=_alpha*Math::fcos(a)
+        +_next90rp->getrealAlpha()*Math::fsin(a);
     else
-        _alphaalt=_alpha*Math::cos(a)
-        +_last90rp->getrealAlpha()*Math::sin(-a);
+        _alphaalt=_alpha*Math::fcos(a)
+        +_last90rp->getrealAlpha()*Math::fsin(-a);
     //calculate the rotation of the fuselage, determine
     //the part in the same direction as alpha
     //and add it ro _alphaalt
@@ -98,7 +102,7 @@ void Rotorpart::inititeration(float dt,float *rot)
     //unbalance
     float b;
     b=_rotor->getBalance();
-    float s =Math::sin(_phi+_direction);
+    float s =Math::fsin(_phi+_direction);
     //float c =Math::cos(_phi+_direction);
     if (s>0)
         _balance=(b>0)?(1.-s*(1.-b)):(1.-s)*(1.+b);
@@ -368,7 +372,7 @@ float Rotorpart::calculateAlpha(float* v_rel_air, float rho,
     float incidence, float cyc, float alphaalt, float *torque,
     float *returnlift)
 {
-    float v_local[3],v_local_scalar,lift_moment,v_flap[3],v_help[3];
+    float lift_moment;
     float relgrav = Math::dot3(_normal,_rotor->getGravDirection());
     lift_moment=-_mass*_len*9.81*relgrav;
     *torque=0;//
@@ -377,75 +381,8 @@ float Rotorpart::calculateAlpha(float* v_rel_air, float rho,
     if (returnlift!=NULL) *returnlift=0;
     float flap_omega=(_next90rp->getrealAlpha()-_last90rp->getrealAlpha())
         *_omega / pi;
-    float local_width=_diameter*(1-_rel_len_blade_start)/2.
-        /(float (_number_of_segments));
-    for (int n=0;n<_number_of_segments;n++)
-    {
-        float rel = (n+.5)/(float (_number_of_segments));
-        float r= _diameter *0.5 *(rel*(1-_rel_len_blade_start)
-            +_rel_len_blade_start);
-        float local_incidence=incidence+_twist *rel -
-            _twist *_rel_len_where_incidence_is_measured;
-        float local_chord = _rotor->getChord()*rel+_rotor->getChord()
-            *_rotor->getTaper()*(1-rel);
-        float A = local_chord * local_width;
-        //calculate the local air speed and the incidence to this speed;
-        Math::mul3(_omega * r , _direction_of_movement , v_local);
-
-        // add speed component due to flapping
-        Math::mul3(flap_omega * r,_normal,v_flap);
-        Math::add3(v_flap,v_local,v_local);
-        Math::sub3(v_rel_air,v_local,v_local); 
-        //v_local is now the total airspeed at the blade 
-        //apparent missing: calculating the local_wind = v_rel_air at 
-        //every point of the rotor. It differs due to aircraft-rotation
-        //it is considered in v_flap
-
-        //substract now the component of the air speed parallel to 
-        //the blade;
-        Math::mul3(Math::dot3(v_local,_directionofrotorpart),
-           _directionofrotorpart,v_help);
-        Math::sub3(v_local,v_help,v_local);
-
-        //split into direction and magnitude
-        v_local_scalar=Math::mag3(v_local);
-        if (v_local_scalar!=0)
-            //Math::unit3(v_local,v_help);
-            Math::mul3(1/v_local_scalar,v_local,v_help);
-        float incidence_of_airspeed = Math::asin(Math::clamp(
-            Math::dot3(v_help,_normal),-1,1)) + local_incidence;
-        //ias = incidence_of_airspeed;
-
-        //reduce the ias (Prantl factor)
-        float prantl_factor=2/pi*Math::acos(Math::exp(
-            -_rotor->getNumberOfBlades()/2.*(1-rel)
-             *Math::sqrt(1+1/Math::sqr(Math::tan(
-               pi/2-Math::abs(incidence_of_airspeed-local_incidence))))));
-        incidence_of_airspeed = (incidence_of_airspeed+
-            _rotor->getAirfoilIncidenceNoLift())*prantl_factor
-            *_rotor_correction_factor-_rotor->getAirfoilIncidenceNoLift();
-        //ias = incidence_of_airspeed;
-        float lift_wo_cyc = _rotor->getLiftCoef(incidence_of_airspeed
-            -cyc*_rotor_correction_factor*prantl_factor,v_local_scalar)
-            * v_local_scalar * v_local_scalar * A *rho *0.5;
-        float lift_with_cyc = 
-            _rotor->getLiftCoef(incidence_of_airspeed,v_local_scalar)
-            * v_local_scalar * v_local_scalar *A *rho*0.5;
-        float lift=lift_wo_cyc+_relamp*(lift_with_cyc-lift_wo_cyc);
-        //take into account that the rotor is a resonant system where
-        //the cyclic input hase increased result
-        float drag = -_rotor->getDragCoef(incidence_of_airspeed,v_local_scalar) 
-            * v_local_scalar * v_local_scalar * A *rho*0.5;
-        float angle = incidence_of_airspeed - incidence; 
-        //angle between blade movement caused by rotor-rotation and the
-        //total movement of the blade
-
-        lift_moment += r*(lift * Math::cos(angle) 
-            - drag * Math::sin(angle));
-        *torque     += r*(drag * Math::cos(angle) 
-            + lift * Math::sin(angle));
-        if (returnlift!=NULL) *returnlift+=lift;
-    }
+    calcSegments(v_rel_air,rho,incidence,cyc,flap_omega,
+        &lift_moment,torque,returnlift);
     //use 1st order approximation for alpha
     //float alpha=Math::atan2(lift_moment,_centripetalforce * _len); 
     float alpha;
@@ -489,6 +426,114 @@ float Rotorpart::calculateAlpha(float* v_rel_air, float rho,
     return (alpha);
 }
 
+// The segment loop of calculateAlpha(), as a structure of arrays: the
+// segments are taken BLOCK at a time, and each stage is a loop over
+// the block with no branches, so the compiler can evaluate a whole
+// block at once.  The transcendentals are those of the build's math
+// tier; with the approximations there are no library calls left in
+// the loops.  The lift and drag moments are summed per lane, and the
+// lanes in order at the end.
+//
+// Two identities save the rest of the transcendentals.  The airspeed
+// at a segment, less its component along the blade, is linear in the
+// radius: a - r*b, with a and b found once.  And the tangent in the
+// Prandtl factor is that of pi/2 - |asin(d)|, d the sine of the
+// airspeed's incidence, so sqrt(1+1/sqr(tan(...))) is
+// 1/sqrt(1-d*d).
+void Rotorpart::calcSegments(float* v_rel_air, float rho, float incidence,
+    float cyc, float flap_omega, float* lift_moment, float* torque,
+    float* returnlift)
+{
+    calcSegmentsT<Math::TIER>(v_rel_air,rho,incidence,cyc,flap_omega,
+        lift_moment,torque,returnlift);
+}
+
+template<int T> void Rotorpart::calcSegmentsT(float* v_rel_air, float rho,
+    float incidence, float cyc, float flap_omega, float* lift_moment,
+    float* torque, float* returnlift)
+{
+    enum { BLOCK = Rotor::SegmentBlock::SIZE };
+    float a[3],b[3],c[3];
+    Math::mul3(Math::dot3(v_rel_air,_directionofrotorpart),
+        _directionofrotorpart,a);
+    Math::sub3(v_rel_air,a,a);
+    Math::mul3(_omega,_direction_of_movement,c);
+    Math::mul3(flap_omega,_normal,b);
+    Math::add3(b,c,c);
+    Math::mul3(Math::dot3(c,_directionofrotorpart),
+        _directionofrotorpart,b);
+    Math::sub3(c,b,b);
+
+    int nseg=_number_of_segments;
+    float local_width=_diameter*(1-_rel_len_blade_start)/2./nseg;
+    float chord=_rotor->getChord();
+    float taper=_rotor->getTaper();
+    float half_blades=_rotor->getNumberOfBlades()/2.;
+    float a0=_rotor->getAirfoilIncidenceNoLift();
+    float cf=_rotor_correction_factor;
+
+    int i;
+    float moment[BLOCK],tq[BLOCK],lf[BLOCK];
+    for (i=0;i<BLOCK;i++)
+        moment[i]=tq[i]=lf[i]=0;
+    for (int n0=0;n0<nseg;n0+=BLOCK)
+    {
+        int m=nseg-n0<BLOCK?nseg-n0:BLOCK;
+        Rotor::SegmentBlock seg;
+        float r[BLOCK],q[BLOCK];
+
+        // Each segment's airspeed and the incidence to it
+        for (i=0;i<m;i++)
+        {
+            float rel=(n0+i+.5f)/nseg;
+            r[i]=_diameter*0.5f*(rel*(1-_rel_len_blade_start)
+                +_rel_len_blade_start);
+            float local_incidence=incidence
+                +_twist*(rel-_rel_len_where_incidence_is_measured);
+            float A=(chord*rel+chord*taper*(1-rel))*local_width;
+            float vx=a[0]-r[i]*b[0];
+            float vy=a[1]-r[i]*b[1];
+            float vz=a[2]-r[i]*b[2];
+            float v2=vx*vx+vy*vy+vz*vz;
+            float speed=Math::sqrt(v2);
+            float d=vx*_normal[0]+vy*_normal[1]+vz*_normal[2];
+            d=speed>0?Math::clamp(d/speed,-1,1):0;
+            float cos2=1-d*d;
+            cos2=cos2>1e-12f?cos2:1e-12f;
+            float e=-half_blades*(1-rel)/Math::sqrt(cos2);
+            e=e>-80?e:-80;
+            float prantl_factor=2/pi
+                *FastMath::acos<T>(FastMath::expNear<T>(e));
+            float ias=(FastMath::asin<T>(d)+local_incidence+a0)
+                *prantl_factor*cf-a0;
+            seg.incidence[i]=ias;
+            seg.incidenceWoCyc[i]=ias-cyc*cf*prantl_factor;
+            seg.speed[i]=speed;
+            q[i]=v2*A*rho*0.5f;
+        }
+
+        _rotor->getSegmentCoefs(m,&seg,_deferred?_stall:0);
+
+        for (i=0;i<m;i++)
+        {
+            float lift=q[i]*(seg.liftWoCyc[i]
+                +_relamp*(seg.lift[i]-seg.liftWoCyc[i]));
+            float drag=-q[i]*seg.drag[i];
+            float s,c;
+            FastMath::sinCosNear<T>(seg.incidence[i]-incidence,&s,&c);
+            moment[i]+=r[i]*(lift*c-drag*s);
+            tq[i]+=r[i]*(drag*c+lift*s);
+            lf[i]+=lift;
+        }
+    }
+    for (i=0;i<BLOCK;i++)
+    {
+        *lift_moment+=moment[i];
+        *torque+=tq[i];
+        if (returnlift!=NULL) *returnlift+=lf[i];
+    }
+}
+
 // Calculate the aerodynamic force given a wind vector v (in the
 // aircraft's "local" coordinates) and an air density rho.  Returns a
 // torque about the Y axis, too.
@@ -538,12 +583,15 @@ void Rotorpart::calcForce(float* v, float rho,  float* out, float* torque,
     //float vblade=Math::abs(Math::dot3(dirblade,v));
 
     alpha=_alphaalt+(alpha-_alphaalt)*factor;
-    _alpha=alpha;
-    float meancosalpha=(1*Math::cos(_last90rp->getrealAlpha())
-        +1*Math::cos(_next90rp->getrealAlpha())
-        +1*Math::cos(_oppositerp->getrealAlpha())
-        +1*Math::cos(alpha))/4;
-    float schwenkfactor=1-(Math::cos(_lastrp->getrealAlpha())-meancosalpha)*_rotor->getNumberOfParts()/4;
+    if (_deferred)
+        _deferred_alpha=alpha;
+    else
+        _alpha=alpha;
+    float meancosalpha=(1*Math::fcos(_last90rp->getrealAlpha())
+        +1*Math::fcos(_next90rp->getrealAlpha())
+        +1*Math::fcos(_oppositerp->getrealAlpha())
+        +1*Math::fcos(alpha))/4;
+    float schwenkfactor=1-(Math::fcos(_lastrp->getrealAlpha())-meancosalpha)*_rotor->getNumberOfParts()/4;
 
     //missing: consideration of rellenhinge
 
@@ -551,8 +599,8 @@ void Rotorpart::calcForce(float* v, float rho,  float* out, float* torque,
     _centripetalforce*=_balance;
     scalar_torque*=_balance;
 
-    float xforce = Math::cos(alpha)*_centripetalforce;
-    float zforce = schwenkfactor*Math::sin(alpha)*_centripetalforce;
+    float xforce = Math::fcos(alpha)*_centripetalforce;
+    float zforce = schwenkfactor*Math::fsin(alpha)*_centripetalforce;
     *torque_scalar=scalar_torque;
     scalar_torque+= 0*_ddt_omega*_torque_of_inertia;
     float thetorque = scalar_torque;
@@ -564,6 +612,13 @@ void Rotorpart::calcForce(float* v, float rho,  float* out, float* torque,
     }
 }
 
+void Rotorpart::commit()
+{
+    _alpha=_deferred_alpha;
+    _rotor->addStall(_stall);
+    _stall[0]=_stall[1]=0;
+}
+
 void Rotorpart::getAccelTorque(float relaccel,float *t)
 {
     float f=_rotor->getCcw()?1:-1;
@@ -623,4 +678,20 @@ std::ostream &  operator<<(std::ostream & out, const Rotorpart& rp)
 #undef iv
     return out;  
 }
+void Rotorpart::hashState(StateHash* h)
+{
+    h->add(_dt);
+    h->add(_last_torque, 3);
+    h->add(_speed, 3);
+    h->add(_cyclic);
+    h->add(_collective);
+    h->add(_alpha);
+    h->add(_alphaalt);
+    h->add(_omega);
+    h->add(_omegan);
+    h->add(_ddt_omega);
+    h->add(_phi);
+    h->add(_torque);
+}
+
 }; // namespace yasim
@@ -4,6 +4,7 @@
 
 namespace yasim {
     class Rotor;
+    class StateHash;
     class Rotorpart
     {
         friend std::ostream &  operator<<(std::ostream & out, const Rotorpart& rp);
@@ -76,9 +77,23 @@ namespace yasim {
         void setSharedFlapHinge(bool s);
         void setDirection(float direction);
         float getAlphaAlt() {return _alphaalt;}
+        void hashState(StateHash* h);
+
+        // Deferred, calcForce() keeps the new flapping angle and the
+        // stall sums to itself until commit(), so that the parts of a
+        // rotor (which read their neighbours' angles) can be evaluated
+        // in any order, or at once, from the angles of the last call.
+        void setDeferred(bool d) {_deferred=d;_deferred_alpha=_alpha;}
+        void commit();
 
     private:
         void strncpy(char *dest,const char *src,int maxlen);
+        void calcSegments(float* v_rel_air, float rho, float incidence,
+            float cyc, float flap_omega, float* lift_moment, float* torque,
+            float* returnlift);
+        template<int T> void calcSegmentsT(float* v_rel_air, float rho,
+            float incidence, float cyc, float flap_omega, float* lift_moment,
+            float* torque, float* returnlift);
         Rotorpart *_lastrp,*_nextrp,*_oppositerp,*_last90rp,*_next90rp;
         Rotor *_rotor;
 
@@ -101,6 +116,9 @@ namespace yasim {
         float _mass;
         float _alpha;
         float _alphaalt;
+        bool _deferred;
+        float _deferred_alpha;
+        float _stall[2];  // for Rotor::addStall() when deferred
         float _alphamin,_alphamax,_alpha0,_alpha0factor;
         float _rellenhinge;
         float _relamp;
@@ -0,0 +1,41 @@
+#ifndef _STATEHASH_HPP
+#define _STATEHASH_HPP
+
+#include <stdint.h>
+
+namespace yasim {
+
+//
+// A 64 bit FNV-1a digest over the raw bits of simulation state.  Used
+// by the deterministic mode to fingerprint every step, so that two
+// runs (or two builds) can be compared and the first step at which
+// they diverge found.  Values are hashed bit for bit: -0 and 0 differ,
+// as do different NaNs, on purpose.
+//
+class StateHash {
+public:
+    StateHash() { _h = 0xcbf29ce484222325ULL; }
+
+    void add(const void* data, int len) {
+        const unsigned char* p = (const unsigned char*)data;
+        for(int i=0; i<len; i++) {
+            _h ^= p[i];
+            _h *= 0x100000001b3ULL;
+        }
+    }
+
+    void add(float f)  { add((const void*)&f, (int)sizeof(f)); }
+    void add(double d) { add((const void*)&d, (int)sizeof(d)); }
+    void add(int i)    { add((const void*)&i, (int)sizeof(i)); }
+    void add(bool b)   { unsigned char c = b; add((const void*)&c, 1); }
+    void add(float* v, int n) { add((const void*)v, n*(int)sizeof(float)); }
+    void add(double* v, int n) { add((const void*)v, n*(int)sizeof(double)); }
+
+    uint64_t get() { return _h; }
+
+private:
+    uint64_t _h;
+};
+
+}; // namespace yasim
+#endif // _STATEHASH_HPP
@@ -21,11 +21,12 @@ Surface::Surface()
     _chord = 0;
     _incidence = 0;
     _twist = 0;
-    _slatPos = _spoilerPos = _flapPos = 0;
+    _ownControls[FLAP] = _ownControls[SLAT] = _ownControls[SPOILER] = 0;
+    _ownControls[FLAPEFF] = 1;
+    setControls(_ownControls, FLAP, FLAPEFF, SLAT, SPOILER);
     _slatDrag = _spoilerDrag = _flapDrag = 1;
 
     _flapLift = 0;
-    _flapEffectiveness = 1;
     _slatAlpha = 0;
     _spoilerLift = 1;
     _inducedDrag = 1;
@@ -128,30 +129,47 @@ void Surface::setSpoilerParams(float liftPenalty, float dragPenalty)
     _spoilerDrag = dragPenalty;
 }
 
+// Only into our own array: a Wing's is shared by all its surfaces.
+void Surface::setControl(int idx, float val)
+{
+    if(_controls == _ownControls)
+        _controls[idx] = val;
+}
+
 void Surface::setFlap(float pos)
 {
-    _flapPos = pos;
+    setControl(_flapIdx, pos);
 }
 
 void Surface::setFlapEffectiveness(float effectiveness)
 {
-    _flapEffectiveness = effectiveness;
+    setControl(_flapEffIdx, effectiveness);
 }
 
 double Surface::getFlapEffectiveness()
 {
-    return _flapEffectiveness;
+    return flapEffectiveness();
 }
 
 
+void Surface::setControls(float* controls, int flap, int flapEff, int slat,
+                          int spoiler)
+{
+    _controls = controls;
+    _flapIdx = flap;
+    _flapEffIdx = flapEff;
+    _slatIdx = slat;
+    _spoilerIdx = spoiler;
+}
+
 void Surface::setSlat(float pos)
 {
-    _slatPos = pos;
+    setControl(_slatIdx, pos);
 }
 
 void Surface::setSpoiler(float pos)
 {
-    _spoilerPos = pos;
+    setControl(_spoilerIdx, pos);
 }
 
 // Calculate the aerodynamic force given a wind vector v (in the
@@ -195,7 +213,7 @@ void Surface::calcForce(float* v, float rho, float* out, float* torque)
     
     // Diddle the Z force according to our configuration
     float stallMul = stallFunc(out);
-    stallMul *= 1 + _spoilerPos * (_spoilerLift - 1);
+    stallMul *= 1 + spoilerPos() * (_spoilerLift - 1);
     float stallLift = (stallMul - 1) * _cz * out[2];
     float flaplift = flapLift(out[2]);
 
@@ -306,7 +324,7 @@ float Surface::stallFunc(float* v)
 // stall alpha
 float Surface::flapLift(float alpha)
 {
-    float flapLift = _cz * _flapPos * (_flapLift-1) * _flapEffectiveness;
+    float flapLift = _cz * flapPos() * (_flapLift-1) * flapEffectiveness();
 
     if(_stalls[0] == 0)
         return 0;
@@ -327,7 +345,7 @@ float Surface::controlDrag(float lift, float drag)
     // Negative flap deflections don't affect drag until their lift
     // multiplier exceeds the "camber" (cz0) of the surface.  Use a
     // synthesized "fp" number instead of the actual flap position.
-    float fp = _flapPos;
+    float fp = flapPos();
     if(fp < 0) {
         fp = -fp;
         fp -= _cz0/(_flapLift-1);
@@ -343,8 +361,8 @@ float Surface::controlDrag(float lift, float drag)
 
     // Now multiply by the various control factors
     drag *= 1 + fp * (_flapDrag - 1);
-    drag *= 1 + _spoilerPos * (_spoilerDrag - 1);
-    drag *= 1 + _slatPos * (_slatDrag - 1);
+    drag *= 1 + spoilerPos() * (_spoilerDrag - 1);
+    drag *= 1 + slatPos() * (_slatDrag - 1);
 
     return drag;
 }
@@ -8,6 +8,10 @@ namespace yasim {
 // front, and flaps act (in both lift and drag) toward the back.
 class Surface
 {
+    // Packs our parameters into its arrays
+    friend class SurfaceBank;
+    // Writes them out as C++
+    friend struct GeneratedAircraft;
 public:
     Surface();
 
@@ -29,11 +33,23 @@ public:
     void setSpoilerParams(float liftPenalty, float dragPenalty);
 
     // Positions for the controls, in the range [0:1].  [-1:1] for
-    // flaps, with positive meaning "force goes towards positive Z"
+    // flaps, with positive meaning "force goes towards positive Z".
+    // These (and setFlapEffectiveness()) do nothing on a Wing's
+    // surfaces, whose controls are moved through the Wing.
     void setFlap(float pos);
     void setSlat(float pos);
     void setSpoiler(float pos);
 
+    // The control positions above (and the flap effectiveness) are
+    // kept in a float array, by default one inside the Surface.  A
+    // Wing points all of its surfaces at a single array of its own,
+    // so that moving a control is one store for the whole wing.  Its
+    // surfaces may share slots (the unused controls), so they can't
+    // be set through the Surface any more.
+    enum { FLAP, FLAPEFF, SLAT, SPOILER, NCONTROLS };
+    void setControls(float* controls, int flap, int flapEff, int slat,
+                     int spoiler);
+
     // Modifier for flap lift coefficient, useful for simulating flap blowing etc.
     void setFlapEffectiveness(float effectiveness);
 	double getFlapEffectiveness();
@@ -76,6 +92,12 @@ private:
     float flapLift(float alpha);
     float controlDrag(float lift, float drag);
 
+    float flapPos() { return _controls[_flapIdx]; }
+    float flapEffectiveness() { return _controls[_flapEffIdx]; }
+    float slatPos() { return _controls[_slatIdx]; }
+    float spoilerPos() { return _controls[_spoilerIdx]; }
+    void setControl(int idx, float val);
+
     float _chord;     // X-axis size
     float _c0;        // total force coefficient
     float _cx;        // X-axis force coefficient
@@ -92,13 +114,15 @@ private:
     float _slatDrag;
     float _flapLift;
     float _flapDrag;
-    float _flapEffectiveness;
     float _spoilerLift;
     float _spoilerDrag;
 
-    float _slatPos;
-    float _flapPos;
-    float _spoilerPos;
+    float* _controls; // control positions, see setControls()
+    int _flapIdx;
+    int _flapEffIdx;
+    int _slatIdx;
+    int _spoilerIdx;
+    float _ownControls[NCONTROLS];
     float _incidence;
     float _twist;
     float _inducedDrag;
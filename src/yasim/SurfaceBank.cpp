@@ -0,0 +1,478 @@
+#include "Math.hpp"
+#include "Surface.hpp"
+#include "SurfaceBank.hpp"
+namespace yasim {
+
+SurfaceBank::SurfaceBank()
+{
+    _n = 0;
+    _nblocks = 0;
+    _blocks = 0;
+    _tableRes = 0;
+    _tableSize = 0;
+    _tables = 0;
+    _tableError = 0;
+}
+
+SurfaceBank::~SurfaceBank()
+{
+    delete[] _blocks;
+    delete[] _tables;
+}
+
+void SurfaceBank::resize(int n)
+{
+    _n = n;
+    int nblocks = (n + BLOCK - 1) / BLOCK;
+    if(nblocks == _nblocks)
+        return;
+
+    // Padding lanes are all zero, which evaluates to zero force.
+    delete[] _blocks;
+    _nblocks = nblocks;
+    _blocks = new Block[_nblocks];
+    float* p = (float*)_blocks;
+    for(int i=0; i<_nblocks * (int)(sizeof(Block)/sizeof(float)); i++)
+        p[i] = 0;
+}
+
+void SurfaceBank::load(Vector* surfaces)
+{
+    resize(surfaces->size());
+
+    for(int i=0; i<_n; i++) {
+        Surface* s = (Surface*)surfaces->get(i);
+        int j;
+        for(j=0; j<3; j++) field(PX+j, i) = s->_pos[j];
+        for(j=0; j<9; j++) field(O0+j, i) = s->_orient[j];
+        field(C0, i) = s->_c0;
+        field(CX, i) = s->_cx;
+        field(CY, i) = s->_cy;
+        field(CZ, i) = s->_cz;
+        field(CZ0, i) = s->_cz0;
+        field(CHORD, i) = s->_chord;
+        field(PEAK0, i) = s->_peaks[0];
+        field(PEAK1, i) = s->_peaks[1];
+        for(j=0; j<4; j++) {
+            field(STALL0+j, i) = s->_stalls[j];
+            field(WIDTH0+j, i) = s->_widths[j];
+        }
+        field(SLATALPHA, i) = s->_slatAlpha;
+        field(SLATDRAG, i) = s->_slatDrag;
+        field(FLAPLIFT, i) = s->_flapLift;
+        field(FLAPDRAG, i) = s->_flapDrag;
+        field(FLAPEFF, i) = s->flapEffectiveness();
+        field(SPOILERLIFT, i) = s->_spoilerLift;
+        field(SPOILERDRAG, i) = s->_spoilerDrag;
+        field(SLATPOS, i) = s->slatPos();
+        field(FLAPPOS, i) = s->flapPos();
+        field(SPOILERPOS, i) = s->spoilerPos();
+        field(INCIDENCE, i) = s->_incidence + s->_twist;
+        field(INDUCED, i) = s->_inducedDrag;
+        if(_tableRes) {
+            loadFactors(s, i);
+            _blocks[i/BLOCK].table[i%BLOCK] = i * _tableSize;
+        }
+    }
+}
+
+// The parts of flapLift() and controlDrag() that depend only on the
+// control positions, which are fixed for the whole iteration.
+void SurfaceBank::loadFactors(Surface* s, int i)
+{
+    float fp = s->flapPos();
+    if(fp < 0) {
+        fp = -fp;
+        fp -= s->_cz0/(s->_flapLift-1);
+        if(fp < 0) fp = 0;
+    }
+    field(SPOILERMUL, i) = 1 + s->spoilerPos() * (s->_spoilerLift - 1);
+    field(FLAPCOEF, i) = s->_cz * s->flapPos() * (s->_flapLift-1)
+        * s->flapEffectiveness();
+    field(FLAPDRAGAOA, i) = (s->_flapLift - 1 - s->_cz0) * s->_stalls[0] * fp;
+    field(DRAGMUL, i) = (1 + fp * (s->_flapDrag - 1))
+        * (1 + s->spoilerPos() * (s->_spoilerDrag - 1))
+        * (1 + s->slatPos() * (s->_slatDrag - 1));
+}
+
+// The flap lift fade of Surface::flapLift(), without the flap lift
+// itself.
+static float flapFade(float* stalls, float* widths, float alpha)
+{
+    if(stalls[0] == 0) return 0;
+    if(alpha < stalls[0]) return 1;
+    if(alpha > stalls[0] + widths[0]) return 0;
+    float frac = (alpha - stalls[0]) / widths[0];
+    frac = frac*frac*(3-2*frac);
+    return 1-frac;
+}
+
+// The stall table is indexed by a "diamond angle" d in [-2:2]: the
+// direction of the (x, z) airflow in surface coordinates, like
+// atan2() but without the transcendental.  d = z/(|x|+|z|) for
+// positive x, and wraps around through +/-2 for negative x.  Returns
+// the x and z components for a given d.
+static void diamondDir(float d, float* x, float* z)
+{
+    float a = Math::abs(d);
+    if(a <= 1) { *x = 1 - a;    *z = d; }
+    else       { *x = -(a - 1); *z = d < 0 ? -(2 - a) : 2 - a; }
+}
+
+void SurfaceBank::buildTables(Vector* surfaces, int resolution)
+{
+    delete[] _tables;
+    _tables = 0;
+    _tableError = 0;
+    _tableRes = resolution > 0 ? ((resolution + 3) / 4) * 4 : 0;
+    if(!_tableRes) {
+        load(surfaces);
+        return;
+    }
+
+    // Stall multiplier over d, then flap fade over |z| in [0:1] at
+    // the same spacing.
+    int nq = _tableRes/4;
+    _tableSize = (_tableRes + 1) + (nq + 1);
+    _tables = new float[surfaces->size() * _tableSize];
+
+    int i, j, k;
+    for(i=0; i<surfaces->size(); i++) {
+        Surface* s = (Surface*)surfaces->get(i);
+        float* stall = _tables + i*_tableSize;
+        float* fade = stall + _tableRes + 1;
+        float v[3];
+        v[1] = 0;
+        for(j=0; j<=_tableRes; j++) {
+            diamondDir(-2 + j*(4.0f/_tableRes), &v[0], &v[2]);
+            stall[j] = s->stallFunc(v);
+        }
+        for(j=0; j<=nq; j++)
+            fade[j] = flapFade(s->_stalls, s->_widths, j*(1.0f/nq));
+
+        // Check between the samples.  The error in the Z force
+        // coefficient is the stall multiplier error times the (unit)
+        // z airflow, plus the fade error times the full flap lift.
+        float flapMax = Math::abs((s->_flapLift-1) * s->flapEffectiveness());
+        for(j=0; j<_tableRes; j++) {
+            for(k=1; k<8; k++) {
+                float frac = k * 0.125f;
+                diamondDir(-2 + (j+frac)*(4.0f/_tableRes), &v[0], &v[2]);
+                float err = stall[j] + frac*(stall[j+1]-stall[j])
+                    - s->stallFunc(v);
+                err *= v[2] / Math::sqrt(v[0]*v[0] + v[2]*v[2]);
+                err = Math::abs(err);
+                if(j < nq) {
+                    float alpha = (j+frac)*(1.0f/nq);
+                    float ferr = fade[j] + frac*(fade[j+1]-fade[j])
+                        - flapFade(s->_stalls, s->_widths, alpha);
+                    err += Math::abs(ferr) * flapMax;
+                }
+                if(err > _tableError) _tableError = err;
+            }
+        }
+    }
+    load(surfaces);
+}
+
+void SurfaceBank::getPosition(int i, float* out)
+{
+    out[0] = field(PX, i);
+    out[1] = field(PY, i);
+    out[2] = field(PZ, i);
+}
+
+void SurfaceBank::setWind(int i, float* v)
+{
+    field(VX, i) = v[0];
+    field(VY, i) = v[1];
+    field(VZ, i) = v[2];
+}
+
+void SurfaceBank::getForce(int i, float* out)
+{
+    out[0] = field(FX, i);
+    out[1] = field(FY, i);
+    out[2] = field(FZ, i);
+}
+
+void SurfaceBank::getTorque(int i, float* out)
+{
+    out[0] = field(TX, i);
+    out[1] = field(TY, i);
+    out[2] = field(TZ, i);
+}
+
+void SurfaceBank::calcForces(float rho)
+{
+    int b;
+    if(_tableRes) {
+        for(b=0; b<_nblocks; b++)
+            calcBlockTables(rho, &_blocks[b]);
+    } else {
+        for(b=0; b<_nblocks; b++)
+            calcBlock(rho, _blocks[b].f);
+    }
+}
+
+// This is Surface::calcForce(), with stallFunc(), flapLift() and
+// controlDrag() folded in and every branch turned into a select.
+// Keep the two in sync.
+void SurfaceBank::calcBlock(float rho, float (*d)[BLOCK])
+{
+    const float* vx = d[VX]; const float* vy = d[VY];
+    const float* vz = d[VZ];
+    const float* o0 = d[O0]; const float* o1 = d[O1];
+    const float* o2 = d[O2]; const float* o3 = d[O3];
+    const float* o4 = d[O4]; const float* o5 = d[O5];
+    const float* o6 = d[O6]; const float* o7 = d[O7];
+    const float* o8 = d[O8];
+    const float* c0 = d[C0]; const float* cx = d[CX];
+    const float* cy = d[CY]; const float* cz = d[CZ];
+    const float* cz0 = d[CZ0]; const float* chord = d[CHORD];
+    const float* peak0 = d[PEAK0]; const float* peak1 = d[PEAK1];
+    const float* stall0 = d[STALL0]; const float* stall1 = d[STALL1];
+    const float* stall2 = d[STALL2]; const float* stall3 = d[STALL3];
+    const float* width0 = d[WIDTH0]; const float* width1 = d[WIDTH1];
+    const float* width2 = d[WIDTH2]; const float* width3 = d[WIDTH3];
+    const float* slatAlpha = d[SLATALPHA];
+    const float* slatDrag = d[SLATDRAG];
+    const float* flapLift = d[FLAPLIFT];
+    const float* flapDrag = d[FLAPDRAG];
+    const float* flapEff = d[FLAPEFF];
+    const float* spoilerLift = d[SPOILERLIFT];
+    const float* spoilerDrag = d[SPOILERDRAG];
+    const float* slatPos = d[SLATPOS];
+    const float* flapPos = d[FLAPPOS];
+    const float* spoilerPos = d[SPOILERPOS];
+    const float* incidence = d[INCIDENCE];
+    const float* induced = d[INDUCED];
+    float* fx = d[FX]; float* fy = d[FY]; float* fz = d[FZ];
+    float* tx = d[TX]; float* ty = d[TY]; float* tz = d[TZ];
+
+    const float zero = 0;
+    for(int i=0; i<BLOCK; i++) {
+        float vel = Math::sqrt(vx[i]*vx[i] + vy[i]*vy[i] + vz[i]*vz[i]);
+        bool noForce = (vel == 0)
+            | ((cx[i] == 0) & (cy[i] == 0) & (cz[i] == 0));
+
+        // Unit wind in surface coordinates, rotated by incidence
+        float ivel = 1/vel;
+        float x = ivel*vx[i], y = ivel*vy[i], z = ivel*vz[i];
+        float sx = x*o0[i] + y*o1[i] + z*o2[i];
+        float sy = x*o3[i] + y*o4[i] + z*o5[i];
+        float sz = x*o6[i] + y*o7[i] + z*o8[i];
+        sz += incidence[i] * sx;
+        float lx = sx, ly = sy, lz = sz;
+
+        // stallFunc().  Load everything first; the selects are then
+        // between registers, not memory.
+        float s0 = stall0[i], s1 = stall1[i], s2 = stall2[i], s3 = stall3[i];
+        float w0 = width0[i], w1 = width1[i], w2 = width2[i], w3 = width3[i];
+        float p0 = peak0[i], p1 = peak1[i], sa = slatAlpha[i];
+        float alpha = Math::abs(sz/sx);
+        bool fwdBak = sx > 0;
+        bool posNeg = sz < 0;
+        float stall = fwdBak ? (posNeg ? s3 : s2) : (posNeg ? s1 : s0);
+        float width = fwdBak ? (posNeg ? w3 : w2) : (posNeg ? w1 : w0);
+        float stallAlpha = (fwdBak | posNeg) ? stall : stall + sa;
+        float scale = 0.5f*(fwdBak ? p1 : p0)/(fwdBak ? s2 : s0);
+        float frac = (alpha - stallAlpha) / width;
+        frac = frac*frac*(3-2*frac);
+        float stallMul = scale*(1-frac) + frac;
+        stallMul = alpha <= stallAlpha ? scale : stallMul;
+        stallMul = ((sx == 0) | (stall == 0) | (alpha > stallAlpha+width))
+            ? 1 : stallMul;
+
+        stallMul *= 1 + spoilerPos[i] * (spoilerLift[i] - 1);
+        float stallLift = (stallMul - 1) * cz[i] * sz;
+
+        // flapLift()
+        float fl = cz[i] * flapPos[i] * (flapLift[i]-1) * flapEff[i];
+        float fa = sz < 0 ? -sz : sz;
+        float ffrac = (fa - s0) / w0;
+        ffrac = ffrac*ffrac*(3-2*ffrac);
+        float flaplift = fa > s0 + w0 ? 0 : fl * (1-ffrac);
+        flaplift = fa < s0 ? fl : flaplift;
+        flaplift = s0 == 0 ? 0 : flaplift;
+
+        sz *= cz[i];
+        sz += cz[i]*cz0[i];
+        sz += stallLift;
+        sz += flaplift;
+
+        float t1 = 0.1667f * chord[i] * (flaplift - (cz[i]*cz0[i] + stallLift));
+        float tqx = zero*o0[i] + t1*o3[i] + zero*o6[i];
+        float tqy = zero*o1[i] + t1*o4[i] + zero*o7[i];
+        float tqz = zero*o2[i] + t1*o5[i] + zero*o8[i];
+
+        // controlDrag()
+        float fpos = flapPos[i];
+        float fp = -fpos;
+        fp -= cz0[i]/(flapLift[i]-1);
+        fp = fp < 0 ? 0 : fp;
+        fp = fpos < 0 ? fp : fpos;
+        float drag = cx[i] * sx;
+        float flapDragAoA = (flapLift[i] - 1 - cz0[i]) * s0;
+        float fd = Math::abs(sz * flapDragAoA * fp);
+        fd = drag < 0 ? -fd : fd;
+        drag += fd;
+        drag *= 1 + fp * (flapDrag[i] - 1);
+        drag *= 1 + spoilerPos[i] * (spoilerDrag[i] - 1);
+        drag *= 1 + slatPos[i] * (slatDrag[i] - 1);
+        sx = drag;
+
+        sy *= cy[i];
+
+        // Induced drag
+        float k = -1*induced[i]*sz*lz;
+        sx = k*lx + sx;
+        sy = k*ly + sy;
+        sz = k*lz + sz;
+
+        sz -= incidence[i] * sx;
+
+        // Back to external coordinates, and to real units
+        float q = 0.5f*rho*vel*vel*c0[i];
+        float ox = sx*o0[i] + sy*o3[i] + sz*o6[i];
+        float oy = sx*o1[i] + sy*o4[i] + sz*o7[i];
+        float oz = sx*o2[i] + sy*o5[i] + sz*o8[i];
+        fx[i] = noForce ? 0 : q*ox;
+        fy[i] = noForce ? 0 : q*oy;
+        fz[i] = noForce ? 0 : q*oz;
+        tx[i] = noForce ? 0 : q*tqx;
+        ty[i] = noForce ? 0 : q*tqy;
+        tz[i] = noForce ? 0 : q*tqz;
+    }
+}
+
+// As calcBlock(), but with the stall and flap lift functions looked
+// up in the tables, and the control factors from loadFactors().  The
+// lookups are done in a scalar loop of their own, between two
+// vectorizable ones; a gather in the middle of the main loop would
+// keep it from being vectorized at all.
+void SurfaceBank::calcBlockTables(float rho, Block* b)
+{
+    float (*d)[BLOCK] = b->f;
+    const int* table = b->table;
+    const float* vx = d[VX]; const float* vy = d[VY];
+    const float* vz = d[VZ];
+    const float* o0 = d[O0]; const float* o1 = d[O1];
+    const float* o2 = d[O2]; const float* o3 = d[O3];
+    const float* o4 = d[O4]; const float* o5 = d[O5];
+    const float* o6 = d[O6]; const float* o7 = d[O7];
+    const float* o8 = d[O8];
+    const float* c0 = d[C0]; const float* cx = d[CX];
+    const float* cy = d[CY]; const float* cz = d[CZ];
+    const float* cz0 = d[CZ0]; const float* chord = d[CHORD];
+    const float* incidence = d[INCIDENCE];
+    const float* induced = d[INDUCED];
+    const float* spoilerMul = d[SPOILERMUL];
+    const float* flapCoef = d[FLAPCOEF];
+    const float* flapDragAoA = d[FLAPDRAGAOA];
+    const float* dragMul = d[DRAGMUL];
+    float* fx = d[FX]; float* fy = d[FY]; float* fz = d[FZ];
+    float* tx = d[TX]; float* ty = d[TY]; float* tz = d[TZ];
+
+    const int n = _tableRes, nq = _tableRes/4;
+    const float fn = n, fnq = nq;
+    const float zero = 0;
+    int i;
+
+    // Wind direction in surface coordinates, and table positions
+    float vel[BLOCK], lx[BLOCK], ly[BLOCK], lz[BLOCK];
+    float frac[BLOCK], ffrac[BLOCK];
+    int k[BLOCK], fk[BLOCK];
+    for(i=0; i<BLOCK; i++) {
+        vel[i] = Math::sqrt(vx[i]*vx[i] + vy[i]*vy[i] + vz[i]*vz[i]);
+        float ivel = 1/vel[i];
+        float x = ivel*vx[i], y = ivel*vy[i], z = ivel*vz[i];
+        float sx = x*o0[i] + y*o1[i] + z*o2[i];
+        float sz = x*o6[i] + y*o7[i] + z*o8[i];
+        sz += incidence[i] * sx;
+        lx[i] = sx;
+        ly[i] = x*o3[i] + y*o4[i] + z*o5[i];
+        lz[i] = sz;
+
+        // Diamond angle.  The clamps also catch the NaNs of the
+        // zero-velocity lanes, which are discarded at the end.
+        float sum = Math::abs(sx) + Math::abs(sz);
+        float p = sz / sum;
+        p = sum > 0 ? p : 0;
+        float dia = sx > 0 ? p : (p >= 0 ? 2 - p : -2 - p);
+        float u = (dia + 2) * (0.25f * fn);
+        u = u > 0 ? u : 0;
+        u = u < fn ? u : fn;
+        int ki = (int)u;
+        ki = ki < n ? ki : n - 1;
+        frac[i] = u - ki;
+        k[i] = table[i] + ki;
+
+        float fu = Math::abs(sz) * fnq;
+        fu = fu < fnq ? fu : fnq;
+        int fki = (int)fu;
+        fki = fki < nq ? fki : nq - 1;
+        ffrac[i] = fu - fki;
+        fk[i] = table[i] + n + 1 + fki;
+    }
+
+    // Lookups
+    float st0[BLOCK], st1[BLOCK], ft0[BLOCK], ft1[BLOCK];
+    for(i=0; i<BLOCK; i++) {
+        st0[i] = _tables[k[i]];
+        st1[i] = _tables[k[i] + 1];
+        ft0[i] = _tables[fk[i]];
+        ft1[i] = _tables[fk[i] + 1];
+    }
+
+    // Forces
+    for(i=0; i<BLOCK; i++) {
+        bool noForce = (vel[i] == 0)
+            | ((cx[i] == 0) & (cy[i] == 0) & (cz[i] == 0));
+        float sx = lx[i], sy = ly[i], sz = lz[i];
+
+        float stallMul = st0[i] + frac[i]*(st1[i] - st0[i]);
+        stallMul *= spoilerMul[i];
+        float stallLift = (stallMul - 1) * cz[i] * sz;
+        float flaplift = flapCoef[i] * (ft0[i] + ffrac[i]*(ft1[i] - ft0[i]));
+
+        sz *= cz[i];
+        sz += cz[i]*cz0[i];
+        sz += stallLift;
+        sz += flaplift;
+
+        float t1 = 0.1667f * chord[i] * (flaplift - (cz[i]*cz0[i] + stallLift));
+        float tqx = zero*o0[i] + t1*o3[i] + zero*o6[i];
+        float tqy = zero*o1[i] + t1*o4[i] + zero*o7[i];
+        float tqz = zero*o2[i] + t1*o5[i] + zero*o8[i];
+
+        float drag = cx[i] * sx;
+        float fd = Math::abs(sz * flapDragAoA[i]);
+        fd = drag < 0 ? -fd : fd;
+        drag += fd;
+        drag *= dragMul[i];
+        sx = drag;
+
+        sy *= cy[i];
+
+        float ki = -1*induced[i]*sz*lz[i];
+        sx = ki*lx[i] + sx;
+        sy = ki*ly[i] + sy;
+        sz = ki*lz[i] + sz;
+
+        sz -= incidence[i] * sx;
+
+        float q = 0.5f*rho*vel[i]*vel[i]*c0[i];
+        float ox = sx*o0[i] + sy*o3[i] + sz*o6[i];
+        float oy = sx*o1[i] + sy*o4[i] + sz*o7[i];
+        float oz = sx*o2[i] + sy*o5[i] + sz*o8[i];
+        fx[i] = noForce ? 0 : q*ox;
+        fy[i] = noForce ? 0 : q*oy;
+        fz[i] = noForce ? 0 : q*oz;
+        tx[i] = noForce ? 0 : q*tqx;
+        ty[i] = noForce ? 0 : q*tqy;
+        tz[i] = noForce ? 0 : q*tqz;
+    }
+}
+
+}; // namespace yasim
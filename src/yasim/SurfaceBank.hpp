@@ -0,0 +1,108 @@
+#ifndef _SURFACEBANK_HPP
+#define _SURFACEBANK_HPP
+
+#include "Vector.hpp"
+
+namespace yasim {
+
+class Surface;
+
+//
+// A structure-of-arrays copy of the Model's aerodynamic surfaces.
+//
+// The parameters of every Surface are packed into contiguous float
+// arrays once per iteration (from Model::initIteration(), after the
+// controls have been applied), and the forces are then evaluated for
+// all surfaces in a single branch-free loop in each of the four
+// Runge-Kutta calls to Model::calcForces().  The surfaces are stored
+// in blocks of BLOCK, each field a fixed size array within the block,
+// so the compiler can evaluate a whole block at once (one AVX
+// register, or a pair of SSE registers, per field).  Unused lanes in
+// the last block are zero and produce no force.
+//
+// The arithmetic is exactly that of Surface::calcForce(), in the same
+// order, so the results are bit-identical to the per-object path.
+//
+// Optionally (buildTables()) the stall and flap lift functions are
+// replaced by per-surface lookup tables, linearly interpolated, and
+// the control settings are folded into a few per-surface factors at
+// load time.  That is not bit-identical; the largest table error is
+// measured when the tables are built.  It is meant for targets where
+// the analytic kernel doesn't vectorize well; yasim-test -T compares
+// the two.
+//
+class SurfaceBank {
+public:
+    enum { BLOCK = 8 };
+
+    SurfaceBank();
+    ~SurfaceBank();
+
+    // Re-packs the parameters and control state from the Surface
+    // objects.
+    void load(Vector* surfaces);
+
+    int size() { return _n; }
+
+    void getPosition(int i, float* out);
+
+    // The local airflow at each surface, as computed by
+    // Model::localWind().
+    void setWind(int i, float* v);
+
+    // Computes force and torque for every surface.
+    void calcForces(float rho);
+
+    // Tabulates the stall and flap lift functions of every surface
+    // with "resolution" intervals around the full circle of angle of
+    // attack (rounded up to a multiple of 4).  Zero goes back to the
+    // analytic functions.  Must be called again if the surfaces'
+    // stall or flap parameters change.
+    void buildTables(Vector* surfaces, int resolution);
+    int getTableResolution() { return _tableRes; }
+
+    // The largest error of the tables against the analytic functions,
+    // as a fraction of a surface's Z force coefficient.
+    float getTableError() { return _tableError; }
+
+    void getForce(int i, float* out);
+    void getTorque(int i, float* out);
+
+private:
+    enum { PX, PY, PZ,
+           O0, O1, O2, O3, O4, O5, O6, O7, O8,
+           C0, CX, CY, CZ, CZ0, CHORD,
+           PEAK0, PEAK1,
+           STALL0, STALL1, STALL2, STALL3,
+           WIDTH0, WIDTH1, WIDTH2, WIDTH3,
+           SLATALPHA, SLATDRAG, FLAPLIFT, FLAPDRAG, FLAPEFF,
+           SPOILERLIFT, SPOILERDRAG,
+           SLATPOS, FLAPPOS, SPOILERPOS, INCIDENCE, INDUCED,
+           SPOILERMUL, FLAPCOEF, FLAPDRAGAOA, DRAGMUL, // table mode
+           VX, VY, VZ,
+           FX, FY, FZ, TX, TY, TZ,
+           NFIELDS };
+
+    struct Block {
+        float f[NFIELDS][BLOCK];
+        int table[BLOCK]; // offset into _tables
+    };
+
+    float& field(int f, int i) { return _blocks[i/BLOCK].f[f][i%BLOCK]; }
+    void resize(int n);
+    void loadFactors(Surface* s, int i);
+    void calcBlock(float rho, float (*d)[BLOCK]);
+    void calcBlockTables(float rho, Block* b);
+
+    int _n;       // number of surfaces
+    int _nblocks;
+    Block* _blocks;
+
+    int _tableRes;    // intervals around the circle, 0 for no tables
+    int _tableSize;   // floats per surface
+    float* _tables;
+    float _tableError;
+};
+
+}; // namespace yasim
+#endif // _SURFACEBANK_HPP
@@ -1,4 +1,5 @@
 #include "Math.hpp"
+#include "StateHash.hpp"
 #include "Thruster.hpp"
 namespace yasim {
 
@@ -69,4 +70,16 @@ void Thruster::setAir(float pressure, float temp, float density)
     _rho = density;
 }
 
+void Thruster::hashState(StateHash* h)
+{
+    h->add(_throttle);
+    h->add(_mixture);
+    h->add(_starter);
+    h->add(_fuel);
+    h->add(_wind, 3);
+    h->add(_pressure);
+    h->add(_temp);
+    h->add(_rho);
+}
+
 }; // namespace yasim
@@ -7,6 +7,8 @@ class Jet;
 class PropEngine;
 class Propeller;
 class Engine;
+class ElectricMotor;
+class StateHash;
 
 class Thruster {
 public:
@@ -20,6 +22,7 @@ public:
     virtual PropEngine* getPropEngine() { return 0; }
     virtual Propeller* getPropeller() { return 0; }
     virtual Engine* getEngine() { return 0; }
+    virtual ElectricMotor* getElectricMotor() { return 0; }
     
     // Static data
     void getPosition(float* out);
@@ -48,6 +51,14 @@ public:
     virtual void integrate(float dt)=0;
     virtual void stabilize()=0;
 
+    // The rate (Hz) this type's dynamics need integrating at, when the
+    // Model is allowed to integrate thrusters less often than every
+    // step (see ThrusterBank).  Zero is every step.
+    virtual float getUpdateRate() { return 0; }
+
+    // Adds the runtime state to a digest, for the deterministic mode.
+    virtual void hashState(StateHash* h);
+
 protected:
     float _pos[3];
     float _dir[3];
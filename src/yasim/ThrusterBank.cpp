@@ -0,0 +1,227 @@
+#include "Math.hpp"
+#include "ElectricMotor.hpp"
+#include "Jet.hpp"
+#include "PropEngine.hpp"
+#include "ThrusterBank.hpp"
+namespace yasim {
+
+ThrusterBank::ThrusterBank()
+{
+    _n = 0;
+    _size = 0;
+    _thrusters = 0;
+    _order = 0;
+    _motors = 0;
+    _pos = _thrust = _torque = _gyro = 0;
+    _last = _slope = 0;
+    for(int k=0; k<=NKINDS; k++) _start[k] = 0;
+    for(int k=0; k<NKINDS; k++) _interval[k] = 0;
+    setDecimation(DECIMATE_OFF);
+}
+
+ThrusterBank::~ThrusterBank()
+{
+    delete[] _thrusters;
+    delete[] _order;
+    delete[] _motors;
+    delete[] _pos;
+    delete[] _thrust;
+    delete[] _torque;
+    delete[] _gyro;
+    delete[] _last;
+    delete[] _slope;
+}
+
+void ThrusterBank::resize(int n)
+{
+    _n = n;
+    if(n <= _size)
+        return;
+    delete[] _thrusters;
+    delete[] _order;
+    delete[] _motors;
+    delete[] _pos;
+    delete[] _thrust;
+    delete[] _torque;
+    delete[] _gyro;
+    delete[] _last;
+    delete[] _slope;
+    _size = n;
+    _thrusters = new Thruster*[n];
+    _order = new int[n];
+    _motors = new ElectricMotor*[n];
+    _pos = new float[3*n];
+    _thrust = new float[3*n];
+    _torque = new float[3*n];
+    _gyro = new float[3*n];
+    _last = new float[9*n];
+    _slope = new float[9*n];
+}
+
+void ThrusterBank::setDecimation(int mode)
+{
+    _decimation = mode;
+    for(int k=0; k<NKINDS; k++) _since[k] = -1;
+}
+
+void ThrusterBank::load(Vector* thrusters)
+{
+    resize(thrusters->size());
+
+    int i, k, kind[NKINDS+1];
+    for(k=0; k<=NKINDS; k++) _start[k] = 0;
+    for(i=0; i<_n; i++) {
+        Thruster* t = (Thruster*)thrusters->get(i);
+        _thrusters[i] = t;
+        for(k=0; k<3; k++)
+            _thrust[3*i+k] = _torque[3*i+k] = _gyro[3*i+k] = 0;
+        t->getPosition(_pos + 3*i);
+
+        // Count each kind, then place them
+        if(t->getElectricMotor()) _start[ELECTRIC+1]++;
+        else if(t->getPropEngine()) _start[PROP+1]++;
+        else if(t->getJet()) _start[JET+1]++;
+        else _start[OTHER+1]++;
+    }
+    for(k=0; k<NKINDS; k++) _start[k+1] += _start[k];
+    for(k=0; k<=NKINDS; k++) kind[k] = _start[k];
+    for(i=0; i<_n; i++) {
+        Thruster* t = _thrusters[i];
+        if(t->getElectricMotor()) {
+            _motors[kind[ELECTRIC]] = t->getElectricMotor();
+            _order[kind[ELECTRIC]++] = i;
+        }
+        else if(t->getPropEngine()) _order[kind[PROP]++] = i;
+        else if(t->getJet()) _order[kind[JET]++] = i;
+        else _order[kind[OTHER]++] = i;
+    }
+
+    // One rate for each kind, but anything else might be anything
+    for(k=0; k<NKINDS; k++) {
+        float rate = 0;
+        if(k != OTHER && _start[k] < _start[k+1])
+            rate = _thrusters[_order[_start[k]]]->getUpdateRate();
+        _interval[k] = rate > 0 ? 1/rate : 0;
+        _since[k] = -1;
+    }
+}
+
+float* ThrusterBank::getPositions()
+{
+    for(int i=0; i<_n; i++)
+        _thrusters[i]->getPosition(_pos + 3*i);
+    return _pos;
+}
+
+void ThrusterBank::integrate(float* wind, float pressure, float temp,
+                             float rho, float dt)
+{
+    int i, j, k, kind;
+    for(kind=0; kind<NKINDS; kind++) {
+        if(_start[kind] == _start[kind+1])
+            continue;
+
+        // Is this kind due?  If not, hold or extrapolate.  The first
+        // step always is.
+        float kdt = dt;
+        bool first = true;
+        if(_decimation != DECIMATE_OFF && _since[kind] >= 0) {
+            first = false;
+            _since[kind] += dt;
+            if(_since[kind] + 0.5f*dt < _interval[kind]) {
+                if(_decimation == DECIMATE_EXTRAPOLATE)
+                    extrapolate(kind);
+                continue;
+            }
+            kdt = _since[kind];
+        }
+        _since[kind] = 0;
+
+        for(k=_start[kind]; k<_start[kind+1]; k++) {
+            i = _order[k];
+            _thrusters[i]->setWind(wind + 3*i);
+            _thrusters[i]->setAir(pressure, temp, rho);
+        }
+        integrateKind(kind, kdt);
+
+        if(_decimation == DECIMATE_OFF)
+            continue;
+        for(k=_start[kind]; k<_start[kind+1]; k++) {
+            i = _order[k];
+            float* last = _last + 9*i;
+            float* slope = _slope + 9*i;
+            float* out[3] = { _thrust + 3*i, _torque + 3*i, _gyro + 3*i };
+            for(j=0; j<9; j++) {
+                float v = out[j/3][j%3];
+                slope[j] = first ? 0 : (v - last[j]) / kdt;
+                last[j] = v;
+            }
+        }
+    }
+}
+
+// The outputs of a kind between its updates, carried on along their
+// change over the last one.
+void ThrusterBank::extrapolate(int kind)
+{
+    float t = _since[kind];
+    for(int k=_start[kind]; k<_start[kind+1]; k++) {
+        int i = _order[k];
+        float* last = _last + 9*i;
+        float* slope = _slope + 9*i;
+        for(int j=0; j<3; j++) {
+            _thrust[3*i+j] = last[j] + t*slope[j];
+            _torque[3*i+j] = last[3+j] + t*slope[3+j];
+            _gyro[3*i+j] = last[6+j] + t*slope[6+j];
+        }
+    }
+}
+
+// One loop per kind.  The qualified calls bind at compile time.
+void ThrusterBank::integrateKind(int kind, float dt)
+{
+    int i, k;
+    switch(kind) {
+    case ELECTRIC:
+        ElectricMotor::integrateAll(_motors, _start[ELECTRIC+1], dt);
+        for(k=_start[ELECTRIC]; k<_start[ELECTRIC+1]; k++) {
+            ElectricMotor* m = _motors[k];
+            i = _order[k];
+            m->ElectricMotor::getThrust(_thrust + 3*i);
+            m->ElectricMotor::getTorque(_torque + 3*i);
+            m->ElectricMotor::getGyro(_gyro + 3*i);
+        }
+        break;
+    case PROP:
+        for(k=_start[PROP]; k<_start[PROP+1]; k++) {
+            i = _order[k];
+            PropEngine* p = (PropEngine*)_thrusters[i];
+            p->PropEngine::integrate(dt);
+            p->PropEngine::getThrust(_thrust + 3*i);
+            p->PropEngine::getTorque(_torque + 3*i);
+            p->PropEngine::getGyro(_gyro + 3*i);
+        }
+        break;
+    case JET:
+        for(k=_start[JET]; k<_start[JET+1]; k++) {
+            i = _order[k];
+            Jet* j = (Jet*)_thrusters[i];
+            j->Jet::integrate(dt);
+            j->Jet::getThrust(_thrust + 3*i);
+            j->Jet::getTorque(_torque + 3*i);
+            j->Jet::getGyro(_gyro + 3*i);
+        }
+        break;
+    default:
+        for(k=_start[OTHER]; k<_start[OTHER+1]; k++) {
+            i = _order[k];
+            Thruster* t = _thrusters[i];
+            t->integrate(dt);
+            t->getThrust(_thrust + 3*i);
+            t->getTorque(_torque + 3*i);
+            t->getGyro(_gyro + 3*i);
+        }
+    }
+}
+
+}; // namespace yasim
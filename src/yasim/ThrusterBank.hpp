@@ -0,0 +1,86 @@
+#ifndef _THRUSTERBANK_HPP
+#define _THRUSTERBANK_HPP
+
+#include "Vector.hpp"
+
+namespace yasim {
+
+class Thruster;
+class ElectricMotor;
+
+//
+// The Model's thrusters, grouped by type.
+//
+// load() sorts the thrusters once, when the list changes, into a
+// contiguous run per concrete type.  Each step, integrate() updates
+// every run in its own loop, calling that type's methods directly
+// rather than through the Thruster interface (electric motors all go
+// to ElectricMotor::integrateAll() in one call), and copies each
+// thruster's thrust, torque and gyroscopic moment into flat arrays,
+// three floats per thruster in the Model's order, together with its
+// position.  Model::calcForces() reads those arrays in each of the
+// four Runge-Kutta calls without going back to the thrusters.
+//
+// The thrusters are independent of each other, so the order they are
+// integrated in changes nothing.
+//
+// Optionally (setDecimation()) each type is integrated only at the
+// rate it declares (Thruster::getUpdateRate()), over the time since
+// it last was, and its outputs are held, or extrapolated along their
+// change over that last update, in the steps between.
+//
+class ThrusterBank {
+public:
+    ThrusterBank();
+    ~ThrusterBank();
+
+    void load(Vector* thrusters);
+
+    enum { DECIMATE_OFF, DECIMATE_HOLD, DECIMATE_EXTRAPOLATE };
+    void setDecimation(int mode);
+    int getDecimation() { return _decimation; }
+
+    int size() { return _n; }
+
+    // The positions, for the wind at each thruster.  Gathered again
+    // by every call, in case a thruster has moved.
+    float* getPositions();
+
+    // Integrates every thruster over dt, in the airflow wind (three
+    // floats per thruster) and the given air.
+    void integrate(float* wind, float pressure, float temp, float rho,
+                   float dt);
+
+    float* getThrust(int i) { return _thrust + 3*i; }
+    float* getTorque(int i) { return _torque + 3*i; }
+    float* getGyro(int i) { return _gyro + 3*i; }
+    float* getPosition(int i) { return _pos + 3*i; }
+
+private:
+    enum { ELECTRIC, PROP, JET, OTHER, NKINDS };
+
+    void resize(int n);
+    void integrateKind(int kind, float dt);
+    void extrapolate(int kind);
+
+    int _n;
+    int _size;
+    Thruster** _thrusters;   // in the Model's order
+    int* _order;             // indices, grouped by kind
+    int _start[NKINDS+1];    // of each kind in _order
+    ElectricMotor** _motors; // the ELECTRIC run
+
+    int _decimation;
+    float _interval[NKINDS]; // between updates, or zero for every step
+    float _since[NKINDS];    // not yet integrated, or -1 for never
+
+    float* _pos;
+    float* _thrust;
+    float* _torque;
+    float* _gyro;
+    float* _last;  // thrust, torque and gyro at the last update
+    float* _slope; // and their change over it
+};
+
+}; // namespace yasim
+#endif // _THRUSTERBANK_HPP
@@ -68,4 +68,18 @@ void TurbineEngine::calc(float pressure, float temp, float omega)
     _n2Target = _running ? _n2Min + (_n2Max - _n2Min) * frac : 0;
 }
 
+void TurbineEngine::hashState(StateHash* h)
+{
+    Engine::hashState(h);
+    h->add(_cond_lever);
+    h->add(_n2Target);
+    h->add(_torqueTarget);
+    h->add(_fuelFlowTarget);
+    h->add(_n2);
+    h->add(_rho);
+    h->add(_omega);
+    h->add(_torque);
+    h->add(_fuelFlow);
+}
+
 }; // namespace yasim
@@ -8,6 +8,7 @@ namespace yasim {
 class TurbineEngine : public Engine {
 public:
     virtual TurbineEngine* isTurbineEngine() { return this; }
+    virtual Engine* clone() { return new TurbineEngine(*this); }
 
     TurbineEngine(float power, float omega, float alt, float flatRating);
     void setN2Range(float low_idle, float high_idle, float max) {
@@ -26,6 +27,9 @@ public:
     }
     virtual float getTorque() { return _torque; }
     virtual float getFuelFlow() { return _fuelFlow; }
+    virtual void hashState(StateHash* h);
+    virtual void hashControls(StateHash* h) {
+        Engine::hashControls(h); h->add(_cond_lever); }
     float getN2() { return _n2; }
 
 private:
@@ -133,45 +133,65 @@ void Turbulence::offset(float* offset)
 void Turbulence::getTurbulence(double* loc, float alt, float* up,
                                float* turbOut)
 {
-    // Convert to integer 2D coordinates; wrap to [0:_sz].
-    double a = (loc[0] + _off[0]) + (loc[2] + _off[2]);
-    double b = (loc[1] + _off[1]) + _timeOff;
-    a -= _sz * Math::floor(a * (1.0/_sz));
-    b -= _sz * Math::floor(b * (1.0/_sz));
-    int x = ((int)Math::floor(a))&(_sz-1);
-    int y = ((int)Math::floor(b))&(_sz-1);
-
-    // Convert to fractional interpolation factors
-    a -= x;
-    b -= y;
-
-    // Do the lookups
-    float turb00[3], turb10[3], turb01[3], turb11[3];
-    turblut(x,     y, turb00);
-    turblut(x+1,   y, turb10);
-    turblut(x,   y+1, turb01);
-    turblut(x+1, y+1, turb11);
-
-    // Interpolate, add in units
-    float mag = _mag * MAX_TURBULENCE;
-    for(int i=0; i<3; i++) {
-        float avg0 = (1-a)*turb00[i] + a*turb01[i];
-        float avg1 = (1-a)*turb10[i] + a*turb11[i];
-        turbOut[i] = mag * ((1-b)*avg0 + b*avg1);
-    }
+    getTurbulence(1, loc, alt, up, turbOut);
+}
 
-    // Adjust for altitude effects
+void Turbulence::getTurbulence(int n, double* loc, float alt, float* up,
+                               float* turbOut)
+{
+    // The magnitude and the altitude effects are the same for every
+    // point.
+    float mag = _mag * MAX_TURBULENCE;
+    float altmul = 1, vmul = 1;
     if(alt < 300) {
-        float altmul = 0.5 + (1-0.5) * (alt*(1.0/300));
+        altmul = 0.5 + (1-0.5) * (alt*(1.0/300));
         if(alt < 100) {
-            float vmul = alt * (1.0/100);
+            vmul = alt * (1.0/100);
             vmul = vmul / altmul; // pre-correct for the pending altmul
-            float dot = Math::dot3(turbOut, up);
-            float off[3];
-            Math::mul3(dot * (vmul-1), up, off);
-            Math::add3(turbOut, off, turbOut);
         }
-        Math::mul3(altmul, turbOut, turbOut);
+    }
+
+    for(int p=0; p<n; p++) {
+        double* l = loc + 3*p;
+        float* u = up + 3*p;
+        float* out = turbOut + 3*p;
+
+        // Convert to integer 2D coordinates; wrap to [0:_sz].
+        double a = (l[0] + _off[0]) + (l[2] + _off[2]);
+        double b = (l[1] + _off[1]) + _timeOff;
+        a -= _sz * Math::floor(a * (1.0/_sz));
+        b -= _sz * Math::floor(b * (1.0/_sz));
+        int x = ((int)Math::floor(a))&(_sz-1);
+        int y = ((int)Math::floor(b))&(_sz-1);
+
+        // Convert to fractional interpolation factors
+        a -= x;
+        b -= y;
+
+        // Do the lookups
+        float turb00[3], turb10[3], turb01[3], turb11[3];
+        turblut(x,     y, turb00);
+        turblut(x+1,   y, turb10);
+        turblut(x,   y+1, turb01);
+        turblut(x+1, y+1, turb11);
+
+        // Interpolate, add in units
+        for(int i=0; i<3; i++) {
+            float avg0 = (1-a)*turb00[i] + a*turb01[i];
+            float avg1 = (1-a)*turb10[i] + a*turb11[i];
+            out[i] = mag * ((1-b)*avg0 + b*avg1);
+        }
+
+        // Adjust for altitude effects
+        if(alt < 300) {
+            if(alt < 100) {
+                float dot = Math::dot3(out, u);
+                float off[3];
+                Math::mul3(dot * (vmul-1), u, off);
+                Math::add3(out, off, out);
+            }
+            Math::mul3(altmul, out, out);
+        }
     }
 }
 
@@ -7,6 +7,11 @@ public:
     void update(double dt, double rate);
     void setMagnitude(double mag);
     void getTurbulence(double* loc, float alt, float* up, float* turbOut);
+
+    // The same for n points at once: loc, up and turbOut hold three
+    // values per point.
+    void getTurbulence(int n, double* loc, float alt, float* up,
+                       float* turbOut);
     void offset(float* dist);
 
 private:
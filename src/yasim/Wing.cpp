@@ -7,6 +7,10 @@ namespace yasim {
 Wing::Wing()
 {
     _mirror = false;
+    int i;
+    for(i=0; i<NCONTROLS; i++)
+        _controls[i] = 0;
+    _controls[FLAP0_EFF] = _controls[FLAP1_EFF] = _controls[ONE] = 1;
     _base[0] = _base[1] = _base[2] = 0;
     _length = 0;
     _chord = 0;
@@ -168,63 +172,35 @@ void Wing::setSpoiler(float start, float end, float lift, float drag)
 
 void Wing::setFlap0(float lval, float rval)
 {
-    lval = Math::clamp(lval, -1, 1);
-    rval = Math::clamp(rval, -1, 1);
-    int i;
-    for(i=0; i<_flap0Surfs.size(); i++) {
-	((Surface*)_flap0Surfs.get(i))->setFlap(lval);
-	if(_mirror) ((Surface*)_flap0Surfs.get(++i))->setFlap(rval);
-    }
+    _controls[FLAP0_L] = Math::clamp(lval, -1, 1);
+    _controls[FLAP0_R] = Math::clamp(rval, -1, 1);
 }
 
 void Wing::setFlap0Effectiveness(float lval)
 {
-    lval = Math::clamp(lval, 1, 10);
-    int i;
-    for(i=0; i<_flap0Surfs.size(); i++) {
-        ((Surface*)_flap0Surfs.get(i))->setFlapEffectiveness(lval);
-//	if(_mirror) ((Surface*)_flap0Surfs.get(++i))->setFlapEffectiveness(rval);
-    }
+    _controls[FLAP0_EFF] = Math::clamp(lval, 1, 10);
 }
 
 void Wing::setFlap1(float lval, float rval)
 {
-    lval = Math::clamp(lval, -1, 1);
-    rval = Math::clamp(rval, -1, 1);
-    int i;
-    for(i=0; i<_flap1Surfs.size(); i++) {
-	((Surface*)_flap1Surfs.get(i))->setFlap(lval);
-	if(_mirror) ((Surface*)_flap1Surfs.get(++i))->setFlap(rval);
-    }
+    _controls[FLAP1_L] = Math::clamp(lval, -1, 1);
+    _controls[FLAP1_R] = Math::clamp(rval, -1, 1);
 }
 
 void Wing::setFlap1Effectiveness(float lval)
 {
-    lval = Math::clamp(lval, 1, 10);
-    int i;
-    for(i=0; i<_flap1Surfs.size(); i++) {
-        ((Surface*)_flap1Surfs.get(i))->setFlapEffectiveness(lval);
-//	if(_mirror) ((Surface*)_flap1Surfs.get(++i))->setFlap(rval);
-    }
+    _controls[FLAP1_EFF] = Math::clamp(lval, 1, 10);
 }
 
 void Wing::setSpoiler(float lval, float rval)
 {
-    lval = Math::clamp(lval, 0, 1);
-    rval = Math::clamp(rval, 0, 1);
-    int i;
-    for(i=0; i<_spoilerSurfs.size(); i++) {
-	((Surface*)_spoilerSurfs.get(i))->setSpoiler(lval);
-	if(_mirror) ((Surface*)_spoilerSurfs.get(++i))->setSpoiler(rval);
-    }
+    _controls[SPOILER_L] = Math::clamp(lval, 0, 1);
+    _controls[SPOILER_R] = Math::clamp(rval, 0, 1);
 }
 
 void Wing::setSlat(float val)
 {
-    val = Math::clamp(val, 0, 1);
-    int i;
-    for(i=0; i<_slatSurfs.size(); i++)
-	((Surface*)_slatSurfs.get(i))->setSlat(val);
+    _controls[SLAT] = Math::clamp(val, 0, 1);
 }
 
 float Wing::getGroundEffect(float* posOut)
@@ -367,7 +343,7 @@ void Wing::compile()
             float chord = _chord * (1 - (1-_taper)*frac);
 
             Surface *s = newSurface(pos, orient, chord,
-                                    flap0, flap1, slat, spoiler);
+                                    flap0, flap1, slat, spoiler, false);
 
             SurfRec *sr = new SurfRec();
             sr->surface = s;
@@ -379,7 +355,7 @@ void Wing::compile()
             if(_mirror) {
 		pos[1] = -pos[1];
                 s = newSurface(pos, rightOrient, chord,
-                               flap0, flap1, slat, spoiler);
+                               flap0, flap1, slat, spoiler, true);
                 sr = new SurfRec();
                 sr->surface = s;
                 sr->weight = chord * segWid;
@@ -424,7 +400,8 @@ float Wing::getLiftRatio()
 }
 
 Surface* Wing::newSurface(float* pos, float* orient, float chord,
-                          bool flap0, bool flap1, bool slat, bool spoiler)
+                          bool flap0, bool flap1, bool slat, bool spoiler,
+                          bool right)
 {
     Surface* s = new Surface();
 
@@ -465,10 +442,13 @@ Surface* Wing::newSurface(float* pos, float* orient, float chord,
     if(slat)    s->setSlatParams(_slatAoA, _slatDrag);
     if(spoiler) s->setSpoilerParams(_spoilerLift, _spoilerDrag);    
 
-    if(flap0)   _flap0Surfs.add(s);
-    if(flap1)   _flap1Surfs.add(s);
-    if(slat)    _slatSurfs.add(s);
-    if(spoiler) _spoilerSurfs.add(s);
+    // Point the surface at the wing's controls.  Where the two flaps
+    // overlap, flap1 wins, as it does for the lift and drag above.
+    int flap = ZERO, flapEff = ONE;
+    if(flap0) { flap = right ? FLAP0_R : FLAP0_L; flapEff = FLAP0_EFF; }
+    if(flap1) { flap = right ? FLAP1_R : FLAP1_L; flapEff = FLAP1_EFF; }
+    s->setControls(_controls, flap, flapEff, slat ? SLAT : ZERO,
+                   spoiler ? (right ? SPOILER_R : SPOILER_L) : ZERO);
 
     s->setInducedDrag(_inducedDrag);
 
@@ -9,6 +9,8 @@ class Surface;
 
 // FIXME: need to handle "inverted" controls for mirrored wings.
 class Wing {
+    // Looks at which of our controls a surface is fed by
+    friend struct GeneratedAircraft;
 public:
     Wing();
     ~Wing();
@@ -30,6 +32,7 @@ public:
     void setTwist(float angle);
     void setCamber(float camber);
     void setIncidence(float incidence);
+    float getIncidence() { return _incidence; }
     void setInducedDrag(float drag) { _inducedDrag = drag; }
     
     void setFlap0(float start, float end, float lift, float drag);
@@ -73,15 +76,19 @@ public:
 private:
     void interp(float* v1, float* v2, float frac, float* out);
     Surface* newSurface(float* pos, float* orient, float chord,
-                        bool flap0, bool flap1, bool slat, bool spoiler);
+                        bool flap0, bool flap1, bool slat, bool spoiler,
+                        bool right);
 
     struct SurfRec { Surface * surface; float weight; };
 
+    // Control positions, shared by all the sub-surfaces (see
+    // Surface::setControls()).  Surfaces without a given control
+    // point at ZERO, or ONE for flap effectiveness.
+    enum { FLAP0_L, FLAP0_R, FLAP1_L, FLAP1_R, SPOILER_L, SPOILER_R,
+           SLAT, FLAP0_EFF, FLAP1_EFF, ZERO, ONE, NCONTROLS };
+
     Vector _surfs;
-    Vector _flap0Surfs;
-    Vector _flap1Surfs;
-    Vector _slatSurfs;
-    Vector _spoilerSurfs;
+    float _controls[NCONTROLS];
 
     bool _mirror;
 
@@ -174,7 +174,10 @@ void YASim::init()
         throw e;
     }
 
-    // Compile it into a real airplane, and tell the user what they got
+    // Compile it into a real airplane, and tell the user what they got.
+    // The fixed-point solver alone reproduces the solutions of older
+    // versions exactly, for comparison.
+    airplane->setNewtonSolver(!fgGetBool("/fdm/yasim/fixed-point-solver", false));
     airplane->compile();
     report();
 
@@ -62,6 +62,11 @@ bool fgGetBool(char const * name, bool def)
     return root->getBoolValue(name, def);
 }
 
+int fgGetInt(char const * name, int def)
+{
+    return root->getIntValue(name, def);
+}
+
 float fgGetFloat (const char * name, float def)
 {
     float f = root->getFloatValue(name, def);
@@ -7,6 +7,7 @@
 bool fgSetFloat (const char * name, float val);
 bool fgSetBool(char const * name, bool val);
 bool fgGetBool(char const * name, bool def);
+int fgGetInt(char const * name, int def = 0);
 bool fgSetString(char const * name, char const * str);
 SGPropertyNode* fgGetNode (const char * path, bool create = false);
 SGPropertyNode* fgGetNode (const char * path, int i, bool create = false);
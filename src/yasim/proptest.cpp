@@ -4,6 +4,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
 
 #include <simgear/misc/sg_path.hxx>
 
@@ -12,11 +15,20 @@
 #include "FGFDM.hpp"
 #include "PropEngine.hpp"
 #include "Propeller.hpp"
+#include "PistonEngine.hpp"
 #include "Atmosphere.hpp"
 
 using namespace yasim;
 
-// Usage: proptest plane.xml [alt-ft] [spd-ktas]
+// Usage: proptest plane.xml [alt-ft] [spd-ktas] [table-resolution]
+//        proptest plane.xml -p map.bin [-t threads] [-T throttle,...]
+//                 [-A alt-ft,...] [-S spd-ktas,...] [-M mixture,...]
+//
+// With a table resolution, also compares the propeller's thrust and
+// torque table (see Propeller::setTable()) against the analytic
+// curves, from 500 to 3000 RPM and up to 250 knots, and a piston
+// engine's tables (see PistonEngine::setTables()) likewise, over the
+// throttle and the same RPM.
 
 static const float KTS2MPS = 0.514444444444;
 static const float RPM2RAD = 0.10471975512;
@@ -37,6 +49,272 @@ static const float N2LB = 0.224809;
 
 const int COUNT = 100;
 
+static void tableSweep(Propeller* prop, float rho, float* thrust,
+                       float* torque, double* ns)
+{
+    const int NSPD = 50;
+    auto t0 = std::chrono::steady_clock::now();
+    for(int i=0; i<NSPD; i++) {
+        float speed = 250 * KTS2MPS * i/(NSPD-1.0);
+        for(int j=0; j<COUNT; j++) {
+            float omega = (500 + 2500 * j/(COUNT-1.0)) * RPM2RAD;
+            prop->calc(rho, speed, omega, &thrust[i*COUNT+j],
+                       &torque[i*COUNT+j]);
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    *ns = std::chrono::duration<double, std::nano>(t1 - t0).count()
+        / (NSPD*COUNT);
+}
+
+static void tableCheck(Propeller* prop, float rho, int resolution)
+{
+    const int N = 50*COUNT;
+    float thrust0[N], torque0[N], thrust[N], torque[N];
+    double ns0, ns;
+    prop->setTable(0);
+    tableSweep(prop, rho, thrust0, torque0, &ns0);
+    float err = prop->setTable(resolution);
+    tableSweep(prop, rho, thrust, torque, &ns);
+    prop->setTable(0);
+
+    float maxT = 0, maxQ = 0, errT = 0, errQ = 0;
+    for(int i=0; i<N; i++) {
+        if(Math::abs(thrust0[i]) > maxT) maxT = Math::abs(thrust0[i]);
+        if(Math::abs(torque0[i]) > maxQ) maxQ = Math::abs(torque0[i]);
+        if(Math::abs(thrust[i] - thrust0[i]) > errT)
+            errT = Math::abs(thrust[i] - thrust0[i]);
+        if(Math::abs(torque[i] - torque0[i]) > errQ)
+            errQ = Math::abs(torque[i] - torque0[i]);
+    }
+
+    printf("\n");
+    printf("Propeller table, resolution %d\n", resolution);
+    printf("-----------------\n");
+    printf("   Table error: %g (of the largest coefficient)\n", err);
+    printf("  Thrust error: %g lbs (%g of the largest)\n", errT * N2LB,
+           errT / maxT);
+    printf("  Torque error: %g N*m (%g of the largest)\n", errQ, errQ / maxQ);
+    printf("      Analytic: %.1f ns/calc\n", ns0);
+    printf("         Table: %.1f ns/calc\n", ns);
+}
+
+static void pistonSweep(PistonEngine* eng, float alt, float* torque,
+                        double* ns)
+{
+    float p = Atmosphere::getStdPressure(alt);
+    float t = Atmosphere::getStdTemperature(alt);
+    auto t0 = std::chrono::steady_clock::now();
+    for(int i=0; i<COUNT; i++) {
+        eng->setThrottle(i/(COUNT-1.0));
+        for(int j=0; j<COUNT; j++) {
+            eng->calc(p, t, (500 + 2500 * j/(COUNT-1.0)) * RPM2RAD);
+            torque[i*COUNT+j] = eng->getTorque();
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    *ns = std::chrono::duration<double, std::nano>(t1 - t0).count()
+        / (COUNT*COUNT);
+}
+
+static void pistonCheck(PistonEngine* eng, float alt)
+{
+    const int N = COUNT*COUNT;
+    float torque0[N], torque[N];
+    double ns0, ns;
+    eng->setRunning(true);
+    eng->setMagnetos(3);
+    pistonSweep(eng, alt, torque0, &ns0);
+    eng->setTables(true);
+    pistonSweep(eng, alt, torque, &ns);
+    eng->setTables(false);
+
+    float max = 0, err = 0;
+    for(int i=0; i<N; i++) {
+        if(Math::abs(torque0[i]) > max) max = Math::abs(torque0[i]);
+        if(Math::abs(torque[i] - torque0[i]) > err)
+            err = Math::abs(torque[i] - torque0[i]);
+    }
+
+    printf("\n");
+    printf("Piston engine tables\n");
+    printf("-----------------\n");
+    printf("   Table error: %g (of the largest value)\n",
+           PistonEngine::getTableError());
+    printf("  Torque error: %g N*m (%g of the largest)\n", err, err / max);
+    printf("      Analytic: %.1f ns/calc\n", ns0);
+    printf("         Table: %.1f ns/calc\n", ns);
+}
+
+// The performance map: every combination of the altitudes, speeds,
+// mixtures and throttles given (the throttle varying fastest), each
+// stabilized from a fresh copy of the first engine, so that no point
+// depends on another and any number of threads gives the same map.
+// Threads take every nthreads'th point.  The file is in native byte
+// order: the magic "YPM1", four int32 grid sizes (altitude, speed,
+// mixture, throttle), each grid as float32s (ft, kts, 0-1, 0-1), then
+// per point five float32s: thrust (lbs), engine torque (N*m), fuel
+// flow (kg/s), RPM and propeller efficiency.
+enum { MAP_ALT, MAP_SPEED, MAP_MIXTURE, MAP_THROTTLE, NMAP };
+static const char MAP_FLAGS[NMAP] = { 'A', 'S', 'M', 'T' };
+enum { OUT_THRUST, OUT_TORQUE, OUT_FUEL, OUT_RPM, OUT_EFF, NOUT };
+
+struct MapAxis { float* vals; int n; };
+
+struct MapWorker {
+    PropEngine* engine;
+    int idx, stride;
+    MapAxis* axes;
+    float* out;
+    int npoints;
+};
+
+static void runMap(MapWorker* w)
+{
+    for(int p=w->idx; p<w->npoints; p+=w->stride) {
+        float v[NMAP];
+        int rest = p;
+        for(int j=NMAP-1; j>=0; j--) {
+            v[j] = w->axes[j].vals[rest % w->axes[j].n];
+            rest /= w->axes[j].n;
+        }
+
+        PropEngine* pe = w->engine->clone();
+        Engine* eng = pe->getEngine();
+        float alt = v[MAP_ALT] * FT2M;
+        float speed = v[MAP_SPEED] * KTS2MPS;
+        float wind[3] = { -speed, 0, 0 };
+        pe->setAir(Atmosphere::getStdPressure(alt),
+                   Atmosphere::getStdTemperature(alt),
+                   Atmosphere::getStdDensity(alt));
+        pe->setWind(wind);
+        pe->setMixture(v[MAP_MIXTURE]);
+        pe->setThrottle(v[MAP_THROTTLE]);
+        pe->stabilize();
+
+        float tmp[3];
+        pe->getThrust(tmp);
+        float thrust = Math::mag3(tmp);
+        float power = pe->getOmega() * eng->getTorque();
+        float* o = w->out + NOUT*p;
+        o[OUT_THRUST] = thrust * N2LB;
+        o[OUT_TORQUE] = eng->getTorque();
+        o[OUT_FUEL] = eng->getFuelFlow();
+        o[OUT_RPM] = pe->getOmega() * (1/RPM2RAD);
+        o[OUT_EFF] = power > 0 ? thrust * speed / power : 0;
+        delete pe;
+    }
+}
+
+// A comma-separated list of numbers.  Returns how many there were, or
+// -1 if there's something else in it.
+static int parseList(const char* s, float* out, int max)
+{
+    int n = 0;
+    while(n < max) {
+        char* end;
+        out[n++] = strtod(s, &end);
+        if(end == s) return -1;
+        if(*end == 0) return n;
+        if(*end != ',') return -1;
+        s = end + 1;
+    }
+    return -1;
+}
+
+static int mapUsage()
+{
+    fprintf(stderr, "Usage: proptest plane.xml -p map.bin [-t threads]"
+            " [-T throttle,...]\n"
+            "                [-A alt-ft,...] [-S spd-ktas,...]"
+            " [-M mixture,...]\n");
+    return 1;
+}
+
+static int propMap(PropEngine* pe, const char* file, int argc, char** argv)
+{
+    static const int MAXVALS = 256;
+    float vals[NMAP][MAXVALS];
+    MapAxis axes[NMAP];
+    int threads = 1;
+    int i, j;
+
+    // Defaults: sea level, standing still, full rich, 0-100% throttle
+    for(j=0; j<NMAP; j++) {
+        axes[j].vals = vals[j];
+        axes[j].n = 1;
+        vals[j][0] = j == MAP_MIXTURE ? 1 : 0;
+    }
+    axes[MAP_THROTTLE].n = 11;
+    for(i=0; i<11; i++) vals[MAP_THROTTLE][i] = i/10.0;
+
+    for(i=0; i<argc; i++) {
+        if(argv[i][0] != '-' || argv[i][2] != 0 || i+1 == argc)
+            return mapUsage();
+        if(argv[i][1] == 't') {
+            threads = atoi(argv[++i]);
+            continue;
+        }
+        for(j=0; j<NMAP; j++)
+            if(argv[i][1] == MAP_FLAGS[j])
+                break;
+        if(j == NMAP) return mapUsage();
+        axes[j].n = parseList(argv[++i], vals[j], MAXVALS);
+        if(axes[j].n < 0) return mapUsage();
+    }
+    if(threads < 1) threads = 1;
+
+    int npoints = 1;
+    for(j=0; j<NMAP; j++) npoints *= axes[j].n;
+    float* out = new float[NOUT*npoints];
+
+    MapWorker* workers = new MapWorker[threads];
+    for(i=0; i<threads; i++) {
+        workers[i].engine = pe;
+        workers[i].idx = i;
+        workers[i].stride = threads;
+        workers[i].axes = axes;
+        workers[i].out = out;
+        workers[i].npoints = npoints;
+    }
+
+    std::thread* pool = new std::thread[threads];
+    auto t0 = std::chrono::steady_clock::now();
+    for(i=1; i<threads; i++)
+        pool[i] = std::thread(runMap, &workers[i]);
+    runMap(&workers[0]);
+    for(i=1; i<threads; i++)
+        pool[i].join();
+    auto t1 = std::chrono::steady_clock::now();
+    delete[] pool;
+    delete[] workers;
+
+    FILE* f = fopen(file, "wb");
+    bool ok = f != 0;
+    if(ok) {
+        int sizes[NMAP];
+        for(j=0; j<NMAP; j++) sizes[j] = axes[j].n;
+        ok = fwrite("YPM1", 1, 4, f) == 4
+            && fwrite(sizes, sizeof(int), NMAP, f) == NMAP;
+        for(j=0; ok && j<NMAP; j++)
+            ok = fwrite(vals[j], sizeof(float), axes[j].n, f)
+                == (size_t)axes[j].n;
+        ok = ok && fwrite(out, sizeof(float), NOUT*npoints, f)
+            == (size_t)(NOUT*npoints);
+        ok = (fclose(f) == 0) && ok;
+    }
+    delete[] out;
+    if(!ok) {
+        fprintf(stderr, "Can't write %s\n", file);
+        return 1;
+    }
+
+    double s = std::chrono::duration<double>(t1 - t0).count();
+    printf("%d points in %.3f s with %d thread(s): %.0f points/s\n",
+           npoints, s, threads, npoints / s);
+    return 0;
+}
+
 int main(int argc, char** argv)
 {
     FGFDM fdm;
@@ -60,6 +338,9 @@ int main(int argc, char** argv)
     pe->setFuelState(true);
     eng->setBoost(1);
 
+    if(argc > 3 && strcmp(argv[2], "-p") == 0)
+        return propMap(pe, argv[3], argc-4, argv+4);
+
     float alt = (argc > 2 ? atof(argv[2]) : 0) * FT2M;
     pe->setAir(Atmosphere::getStdPressure(alt),
                Atmosphere::getStdTemperature(alt),
@@ -107,4 +388,10 @@ int main(int argc, char** argv)
         printf("%7.1f %11.1f %10.1f %7.1f %11.1f\n",
                rpm, thrust * N2LB, power * (1/HP2W), 100*eff, torque);
     }
+
+    if(argc > 4) {
+        tableCheck(prop, Atmosphere::getStdDensity(alt), atoi(argv[4]));
+        if(eng->isPistonEngine())
+            pistonCheck(eng->isPistonEngine(), alt);
+    }
 }
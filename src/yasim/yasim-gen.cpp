@@ -0,0 +1,60 @@
+#include <string>
+#include <cstdio>
+#include <cstring>
+
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/props/props.hxx>
+#include <simgear/xml/easyxml.hxx>
+
+#include "FGFDM.hpp"
+#include "Airplane.hpp"
+#include "GeneratedAircraft.hpp"
+
+using namespace yasim;
+
+// Usage: yasim-gen <ac.xml> <name> <out.cpp>
+//
+// Solves the aircraft and writes it out as C++ (see
+// GeneratedAircraft.hpp).  The name must be a C identifier.
+
+int main(int argc, char** argv)
+{
+    if(argc != 4) {
+        fprintf(stderr, "Usage: yasim-gen <ac.xml> <name> <out.cpp>\n");
+        return 1;
+    }
+
+    FGFDM* fdm = new FGFDM();
+    Airplane* a = fdm->getAirplane();
+    try {
+        std::string file = argv[1];
+        readXML(file, *fdm);
+    } catch (const sg_exception &e) {
+        fprintf(stderr, "XML parse error: %s (%s)\n",
+                e.getFormattedMessage().c_str(), e.getOrigin());
+        delete fdm;
+        return 1;
+    }
+
+    a->compile();
+    if(a->getFailureMsg()) {
+        fprintf(stderr, "SOLUTION FAILURE: %s\n", a->getFailureMsg());
+        delete fdm;
+        return 1;
+    }
+
+    FILE* out = fopen(argv[3], "w");
+    if(!out) {
+        fprintf(stderr, "Cannot write %s\n", argv[3]);
+        delete fdm;
+        return 1;
+    }
+    bool ok = GeneratedAircraft::write(a, argv[2], argv[1], out);
+    ok &= fclose(out) == 0;
+    if(!ok) {
+        fprintf(stderr, "Failed to write %s\n", argv[3]);
+        remove(argv[3]);
+    }
+    delete fdm;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/props/props.hxx>
+#include <simgear/xml/easyxml.hxx>
+
+#include "FGFDM.hpp"
+#include "Atmosphere.hpp"
+#include "Airplane.hpp"
+#include "Surface.hpp"
+#include "GeneratedAircraft.hpp"
+
+using namespace yasim;
+
+// Usage: yasim-gencheck-<name> [ac.xml]
+//
+// Compares the generated aerodynamics of one aircraft (see
+// GeneratedAircraft.hpp) with Surface::calcForce() on the same
+// aircraft loaded from its XML, over a sweep of angle of attack and
+// sideslip, clean and with the wing controls fully deployed.  Prints
+// the largest difference and the time for each.  The build defines
+// YASIM_GEN_NAME as the gen_<name> object to check.
+
+namespace yasim { extern const GeneratedAircraft YASIM_GEN_NAME; }
+
+static const float DEG2RAD = 0.0174532925199;
+static const float KTS2MPS = 0.514444444444;
+
+static const int NAOA = 359, NBETA = 5, REPS = 50;
+
+// The reference: every surface's calcForce(), summed into a force and
+// a moment about the origin.
+static void calcSurfaces(Model* m, float* wind, float rho, float* force,
+                         float* moment)
+{
+    int i;
+    for(i=0; i<3; i++) force[i] = moment[i] = 0;
+    for(i=0; i<m->numSurfaces(); i++) {
+        Surface* s = m->getSurface(i);
+        float f[3], t[3], pos[3], tmp[3];
+        s->calcForce(wind + 3*i, rho, f, t);
+        s->getPosition(pos);
+        Math::add3(f, force, force);
+        Math::cross3(pos, f, tmp);
+        Math::add3(tmp, moment, moment);
+        Math::add3(t, moment, moment);
+    }
+}
+
+// Fills in the same airflow at every surface, for an angle of attack
+// and sideslip in degrees.
+static void setWind(float* wind, int n, float aoa, float beta, float v)
+{
+    float a = aoa * DEG2RAD, b = beta * DEG2RAD;
+    for(int i=0; i<n; i++) {
+        wind[3*i+0] = -v * Math::cos(a) * Math::cos(b);
+        wind[3*i+1] =  v * Math::sin(b);
+        wind[3*i+2] = -v * Math::sin(a) * Math::cos(b);
+    }
+}
+
+static int check(Airplane* a, const GeneratedAircraft* g, const char* what)
+{
+    Model* m = a->getModel();
+    int n = m->numSurfaces();
+    float rho = Atmosphere::getStdDensity(0);
+    float* wind = new float[3*n];
+    float* controls = new float[GeneratedAircraft::NCONTROLS*n];
+    GeneratedAircraft::getControls(m, controls);
+
+    float maxF = 0, maxM = 0, errF = 0, errM = 0;
+    double nsRef = 0, nsGen = 0;
+    int i, j, k, r;
+    for(i=0; i<NAOA; i++) {
+        for(j=0; j<NBETA; j++) {
+            float aoa = i - (NAOA-1)/2, beta = 10*j - 20;
+            float fr[3], mr[3], fg[3], mg[3];
+            setWind(wind, n, aoa, beta, 100 * KTS2MPS);
+
+            auto t0 = std::chrono::steady_clock::now();
+            for(r=0; r<REPS; r++)
+                calcSurfaces(m, wind, rho, fr, mr);
+            auto t1 = std::chrono::steady_clock::now();
+            for(r=0; r<REPS; r++)
+                g->calcAero(wind, controls, rho, fg, mg);
+            auto t2 = std::chrono::steady_clock::now();
+            nsRef += std::chrono::duration<double,std::nano>(t1-t0).count();
+            nsGen += std::chrono::duration<double,std::nano>(t2-t1).count();
+
+            for(k=0; k<3; k++) {
+                if(Math::abs(fr[k]) > maxF) maxF = Math::abs(fr[k]);
+                if(Math::abs(mr[k]) > maxM) maxM = Math::abs(mr[k]);
+                if(Math::abs(fg[k]-fr[k]) > errF) errF = Math::abs(fg[k]-fr[k]);
+                if(Math::abs(mg[k]-mr[k]) > errM) errM = Math::abs(mg[k]-mr[k]);
+            }
+        }
+    }
+    delete[] wind;
+    delete[] controls;
+
+    int evals = NAOA * NBETA * REPS;
+    errF = maxF > 0 ? errF/maxF : 0;
+    errM = maxM > 0 ? errM/maxM : 0;
+    printf("%s:\n", what);
+    printf("  Max force error: %g (of the largest force)\n", errF);
+    printf(" Max moment error: %g (of the largest moment)\n", errM);
+    printf("         Surfaces: %.1f ns\n", nsRef / evals);
+    printf("        Generated: %.1f ns\n", nsGen / evals);
+    return errF > 1e-5 || errM > 1e-5;
+}
+
+int main(int argc, char** argv)
+{
+    const GeneratedAircraft* g = &YASIM_GEN_NAME;
+    const char* file = argc > 1 ? argv[1] : g->source;
+
+    FGFDM* fdm = new FGFDM();
+    Airplane* a = fdm->getAirplane();
+    try {
+        readXML(file, *fdm);
+    } catch (const sg_exception &e) {
+        printf("XML parse error: %s (%s)\n",
+               e.getFormattedMessage().c_str(), e.getOrigin());
+        delete fdm;
+        return 1;
+    }
+    a->compile();
+    if(a->getFailureMsg()) {
+        printf("SOLUTION FAILURE: %s\n", a->getFailureMsg());
+        delete fdm;
+        return 1;
+    }
+    if(a->getModel()->numSurfaces() != g->numSurfaces) {
+        printf("%s has %d surfaces, the generated code %d\n", file,
+               a->getModel()->numSurfaces(), g->numSurfaces);
+        delete fdm;
+        return 1;
+    }
+
+    printf("Generated %s from %s: %d of %d surfaces\n", g->name, g->source,
+           g->numGenerated, g->numSurfaces);
+    int fail = check(a, g, "Clean");
+    Wing* w = a->getWing();
+    if(w) {
+        w->setFlap0(1, 1);
+        w->setFlap1(1, 1);
+        w->setSpoiler(1, 1);
+        w->setSlat(1);
+        fail |= check(a, g, "Flaps, spoilers and slats");
+    }
+    printf("%s\n", fail ? "FAILED: generated code differs" : "OK");
+    delete fdm;
+    return fail;
+}
@@ -2,6 +2,7 @@
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
+#include <vector>
 
 #include <simgear/misc/sg_path.hxx>
 #include <simgear/props/props.hxx>
@@ -17,12 +18,23 @@
 #include "Atmosphere.hpp"
 #include "Airplane.hpp"
 #include "Glue.hpp"
+#include "PropEngine.hpp"
+#include "ElectricMotor.hpp"
+#include "Thruster.hpp"
 
 using namespace yasim;
 
 static const float RAD2DEG = 57.2957795131;
+static const float RAD2RPM = 9.54929658551;
 
 /* TODO: organize these into a better place */
+/* Both command frames start with the magic and flags.  The first has
+ * one throttle, for engine 0; the second one per motor, in engine
+ * order, for multirotors. */
+static const uint32_t COMMAND_MAGIC = 0xb33fbeef;
+static const uint32_t MOTOR_COMMAND_MAGIC = 0xb33fbef0;
+static const int MAX_MOTORS = 8;
+
 struct command {
     uint32_t magic;
     uint32_t flags;
@@ -34,6 +46,20 @@ struct command {
     bool armed;
 };
 
+struct motor_command {
+    uint32_t magic;
+    uint32_t flags;
+
+    float roll, pitch, yaw;
+    float motor[MAX_MOTORS];
+
+    float resv[8];
+
+    bool armed;
+};
+
+static const size_t COMMAND_HEADER = 2 * sizeof(uint32_t);
+
 struct status {
     uint32_t magic;
     uint32_t flags;
@@ -50,20 +76,117 @@ struct status {
     float resv[4];
 };
 
-bool readState(FGFDM *fdm, Airplane *a) {
-    struct command frm;
+/* Where the vehicle waits until armed: trimmed in level flight, or
+ * untrimmed a little faster, as it always used to */
+static const float START_ALT = 100;
+static const float START_SPEED = 50;
+static const float TRIM_SPEED = 40;
+
+static const char* TRIM_AXES[Airplane::NTRIMINPUTS] = {
+    "/controls/engines/engine[0]/throttle",
+    "/controls/flight/elevator",
+    "/controls/flight/aileron",
+    "/controls/flight/rudder" };
+
+static bool trimStart = true;
+static bool trimmed = false;
+static int trimInputs[Airplane::NTRIMINPUTS];
+static float trimVals[Airplane::NTRIMINPUTS] = { 0.5, -0.1, 0, 0.112 };
+static State trimState;
+static std::vector<float> trimRPM;
+
+/* Trims for level flight the first time, then just goes back to that
+ * state, with the controls and propeller speeds at the trim.  FGFDM
+ * takes the propeller speeds from the rpm properties. */
+static bool holdTrim(FGFDM *fdm, Airplane *a)
+{
+    Model *m = a->getModel();
+    char buf[64];
+    int i;
+    if (!trimmed) {
+        for(i=0; i<Airplane::NTRIMINPUTS; i++)
+            trimInputs[i] = fdm->getAxisHandle(TRIM_AXES[i]);
+        fdm->getExternalInput(); /* mixture and the like */
+        if(!a->trim(TRIM_SPEED, START_ALT, 0, 0, 0, trimInputs, trimVals))
+            return false;
+        trimState = *m->getState();
+        for(i=0; i<a->numThrusters(); i++) {
+            Thruster* t = a->getThruster(i);
+            float omega = 0;
+            if(t->getPropEngine())
+                omega = t->getPropEngine()->getOmega();
+            else if(t->getElectricMotor())
+                omega = t->getElectricMotor()->getOmega();
+            trimRPM.push_back(omega * RAD2RPM);
+        }
+        trimmed = true;
+    } else {
+        m->setState(&trimState);
+    }
+    for(i=0; i<Airplane::NTRIMINPUTS; i++)
+        if(trimInputs[i] >= 0)
+            fgSetFloat(TRIM_AXES[i], trimVals[i]);
+    for(i=0; i<a->numThrusters(); i++) {
+        Thruster* t = a->getThruster(i);
+        if(t->getPropEngine() || t->getElectricMotor()) {
+            sprintf(buf, "/engines/engine[%d]/rpm", i);
+            fgSetFloat(buf, trimRPM[i]);
+        }
+    }
+    fdm->getExternalInput();
+    return true;
+}
 
-    ssize_t rd = read(STDIN_FILENO, &frm, sizeof(frm));
+/* Reads exactly len bytes, however many reads that takes */
+static bool readFully(void *buf, size_t len)
+{
+    char *p = (char *) buf;
 
-    if (rd != sizeof(frm)) {
+    while (len > 0) {
+        ssize_t rd = read(STDIN_FILENO, p, len);
+
+        if (rd <= 0) {
+            return false;
+        }
+
+        p += rd;
+        len -= rd;
+    }
+
+    return true;
+}
+
+bool readState(FGFDM *fdm, Airplane *a) {
+    union {
+        struct command cmd;
+        struct motor_command mot;
+    } frm;
+    bool armed;
+
+    /* The header says which frame the rest is */
+    if (!readFully(&frm, COMMAND_HEADER)) {
         return false;
     }
 
-    if (frm.magic != 0xb33fbeef) {
+    if (frm.cmd.magic == COMMAND_MAGIC) {
+        if (!readFully((char *) &frm + COMMAND_HEADER,
+                    sizeof(frm.cmd) - COMMAND_HEADER)) {
+            return false;
+        }
+
+        armed = frm.cmd.armed;
+    } else if (frm.cmd.magic == MOTOR_COMMAND_MAGIC) {
+        if (!readFully((char *) &frm + COMMAND_HEADER,
+                    sizeof(frm.mot) - COMMAND_HEADER)) {
+            return false;
+        }
+
+        armed = frm.mot.armed;
+    } else {
         return false;
     }
 
-    if (!frm.armed) {
+    if (!armed) {
         /* Before arming, hold position and run model... */
         Model *m = a->getModel();
         State *s = m->getState();
@@ -71,15 +194,24 @@ bool readState(FGFDM *fdm, Airplane *a) {
         float xyz2ned[9];
         Glue::xyz2nedMat(0, 0, xyz2ned);
 
-        float alt = 100;
+        float alt = START_ALT;
 
         sgGeodToCart(0, 0, alt, s->pos);
 
+        if (trimStart) {
+            m->updateGround(s);
+            if (holdTrim(fdm, a)) {
+                return true;
+            }
+            SG_LOG(SG_FLIGHT, SG_ALERT, "Trim failed, starting untrimmed");
+            trimStart = false;
+        }
+
         Glue::euler2orient(0, 0, 0, s->orient);
         Math::mmul33(s->orient, xyz2ned, s->orient);
 
         /* Start off going 50 m/s forward */
-        float v[3] = { 50, 0, 0 };
+        float v[3] = { START_SPEED, 0, 0 };
 
         Math::tmul33(s->orient, v, s->v);
 
@@ -98,10 +230,23 @@ bool readState(FGFDM *fdm, Airplane *a) {
         fdm->getExternalInput();
     }
 
-    fgSetFloat("/controls/flight/aileron", frm.roll);
-    fgSetFloat("/controls/flight/elevator", -frm.pitch);
-    fgSetFloat("/controls/flight/rudder", frm.yaw);
-    fgSetFloat("/controls/engines/engine[0]/throttle", frm.throttle);
+    if (frm.cmd.magic == COMMAND_MAGIC) {
+        fgSetFloat("/controls/flight/aileron", frm.cmd.roll);
+        fgSetFloat("/controls/flight/elevator", -frm.cmd.pitch);
+        fgSetFloat("/controls/flight/rudder", frm.cmd.yaw);
+        fgSetFloat("/controls/engines/engine[0]/throttle", frm.cmd.throttle);
+    } else {
+        char buf[64];
+
+        fgSetFloat("/controls/flight/aileron", frm.mot.roll);
+        fgSetFloat("/controls/flight/elevator", -frm.mot.pitch);
+        fgSetFloat("/controls/flight/rudder", frm.mot.yaw);
+
+        for (int i = 0; i < MAX_MOTORS; i++) {
+            sprintf(buf, "/controls/engines/engine[%d]/throttle", i);
+            fgSetFloat(buf, frm.mot.motor[i]);
+        }
+    }
 
     return true;
 }
@@ -172,7 +317,12 @@ bool writeState(Airplane *a)
 
 int usage()
 {
-    fprintf(stderr, "Usage: yasim <ac.xml>\n");
+    fprintf(stderr, "Usage: yasim <ac.xml> [-d] [-u] [-s steps] [-e mode] [-r threads]\n");
+    fprintf(stderr, "       -d  deterministic mode, logs a state hash per step\n");
+    fprintf(stderr, "       -u  wait for arming untrimmed, not in trimmed level flight\n");
+    fprintf(stderr, "       -s  physics steps per 5ms command frame (default 1)\n");
+    fprintf(stderr, "       -e  engine decimation: 1 hold, 2 extrapolate between updates\n");
+    fprintf(stderr, "       -r  rotorparts spread over this many threads (default 0, serial)\n");
     return 1;
 }
 
@@ -188,8 +338,26 @@ int main(int argc, char** argv)
 
     FGFDM* fdm = new FGFDM();
     Airplane* a = fdm->getAirplane();
+    int substeps = 1;
 
     if(argc < 2) return usage();
+    for(int i=2; i<argc; i++) {
+        if(strcmp(argv[i], "-d") == 0)
+            fgSetBool("/fdm/yasim/deterministic", true);
+        else if(strcmp(argv[i], "-u") == 0)
+            trimStart = false;
+        else if(strcmp(argv[i], "-s") == 0 && i+1 < argc)
+            substeps = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-e") == 0 && i+1 < argc)
+            fgGetNode("/fdm/yasim/engine-decimation", true)
+                ->setIntValue(atoi(argv[++i]));
+        else if(strcmp(argv[i], "-r") == 0 && i+1 < argc)
+            fgGetNode("/fdm/yasim/rotor-threads", true)
+                ->setIntValue(atoi(argv[++i]));
+        else
+            return usage();
+    }
+    if(substeps < 1) return usage();
 
     // Read
     try {
@@ -238,7 +406,8 @@ int main(int argc, char** argv)
             break;
         }
 
-        fdm->iterate(1.0f/200.0f);
+        for(int i=0; i<substeps; i++)
+            fdm->iterate(1.0f/(200.0f*substeps));
         t += 1.0/200.0L;
     }
 
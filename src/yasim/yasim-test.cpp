@@ -2,6 +2,8 @@
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
+#include <chrono>
+#include <thread>
 
 #include <simgear/misc/sg_path.hxx>
 #include <simgear/props/props.hxx>
@@ -10,12 +12,16 @@
 #include "FGFDM.hpp"
 #include "Atmosphere.hpp"
 #include "Airplane.hpp"
+#include "Linearizer.hpp"
+#include "AeroDatabase.hpp"
 
 using namespace yasim;
 
 static const float RAD2DEG = 57.2957795131;
 static const float DEG2RAD = 0.0174532925199;
 static const float KTS2MPS = 0.514444444444;
+static const float LBS2KG = 0.45359237;
+static const float FT2M = 0.3048;
 
 
 // Generate a graph of lift, drag and L/D against AoA at the specified
@@ -56,18 +62,721 @@ void yasim_graph(Airplane* a, float alt, float kts)
     }
 }
 
+// Compare the surface lookup tables against the analytic stall and
+// flap functions: the table error reported by the Model, the largest
+// lift and drag differences (in G's) over the yasim_graph() sweep,
+// and the time per Model::calcForces() call for each.
+static void yasim_sweep(Model* m, float kts, float* lift, float* drag, int reps,
+                        double* ns)
+{
+    State s;
+    auto t0 = std::chrono::steady_clock::now();
+    for(int r=0; r<reps; r++) {
+        for(int deg=-179; deg<=179; deg++) {
+            Airplane::setupState(deg * DEG2RAD, kts * KTS2MPS, 0, &s);
+            m->getBody()->reset();
+            m->initIteration(1.0/30);
+            m->calcForces(&s);
+
+            float acc[3];
+            m->getBody()->getAccel(acc);
+            Math::tmul33(s.orient, acc, acc);
+            drag[deg+179] = acc[0] * (-1/9.8);
+            lift[deg+179] = 1 + acc[2] * (1/9.8);
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    *ns = std::chrono::duration<double, std::nano>(t1 - t0).count()
+        / (reps * 359);
+}
+
+void yasim_tables(Airplane* a, int resolution, float alt, float kts)
+{
+    static const int REPS = 200;
+    Model* m = a->getModel();
+    float lift0[359], drag0[359], lift[359], drag[359];
+    double ns0, ns;
+
+    m->setAir(Atmosphere::getStdPressure(alt),
+              Atmosphere::getStdTemperature(alt),
+              Atmosphere::getStdDensity(alt));
+    m->getBody()->recalc();
+
+    m->setSurfaceTables(0);
+    yasim_sweep(m, kts, lift0, drag0, REPS, &ns0);
+    float err = m->setSurfaceTables(resolution);
+    yasim_sweep(m, kts, lift, drag, REPS, &ns);
+    m->setSurfaceTables(0);
+
+    float dl = 0, dd = 0;
+    int worst = 0;
+    for(int i=0; i<359; i++) {
+        if(Math::abs(lift[i] - lift0[i]) > dl) {
+            dl = Math::abs(lift[i] - lift0[i]);
+            worst = i - 179;
+        }
+        if(Math::abs(drag[i] - drag0[i]) > dd)
+            dd = Math::abs(drag[i] - drag0[i]);
+    }
+
+    printf("Surface tables, resolution %d\n", resolution);
+    printf("     Table error: %g (of surface Z coefficient)\n", err);
+    printf("  Max lift error: %g G (at %d deg)\n", dl, worst);
+    printf("  Max drag error: %g G\n", dd);
+    printf("        Analytic: %.1f ns/calcForces\n", ns0);
+    printf("          Tables: %.1f ns/calcForces\n", ns);
+}
+
+// Print the force and moment of each part of the aircraft at the
+// given angle of attack, speed and altitude (controls at zero).
+// Needs a build with YASIM_FORCE_BREAKDOWN.
+int yasim_breakdown(Airplane* a, float aoa, float alt, float kts)
+{
+    Model* m = a->getModel();
+    ForceBreakdown* b = m->getForceBreakdown();
+    if(!b) {
+        fprintf(stderr, "Not built with YASIM_FORCE_BREAKDOWN\n");
+        return 1;
+    }
+
+    State s;
+    m->setAir(Atmosphere::getStdPressure(alt),
+              Atmosphere::getStdTemperature(alt),
+              Atmosphere::getStdDensity(alt));
+    m->getBody()->recalc();
+    Airplane::setupState(aoa * DEG2RAD, kts * KTS2MPS, 0, &s);
+    m->setState(&s);
+    m->getBody()->reset();
+    m->initIteration(1.0/30);
+    m->calcForces(&s);
+
+    printf("Force breakdown at %g deg, %g kts, %g ft (local axes)\n",
+           aoa, kts, alt);
+    printf("  %-14s %10s %10s %10s %10s %10s %10s\n", "", "Fx (N)",
+           "Fy (N)", "Fz (N)", "Mx (N*m)", "My (N*m)", "Mz (N*m)");
+    float total[6] = { 0, 0, 0, 0, 0, 0 };
+    for(int c=0; c<ForceBreakdown::NCATEGORIES; c++) {
+        float* f = b->force[c];
+        float* mo = b->moment[c];
+        if(Math::mag3(f) == 0 && Math::mag3(mo) == 0)
+            continue;
+        char name[32];
+        ForceBreakdown::getName(c, name, sizeof(name));
+        printf("  %-14s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", name,
+               f[0], f[1], f[2], mo[0], mo[1], mo[2]);
+        for(int j=0; j<3; j++) {
+            total[j] += f[j];
+            total[j+3] += mo[j];
+        }
+    }
+    printf("  %-14s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", "total",
+           total[0], total[1], total[2], total[3], total[4], total[5]);
+    return 0;
+}
+
+// Linearize about the solved cruise condition and print the A and B
+// matrices in Octave/MATLAB syntax.  Extra copies of the airplane
+// are loaded to spread the evaluations over several threads.
+static const char* LIN_AXES[] = { "/controls/flight/aileron",
+                                  "/controls/flight/elevator",
+                                  "/controls/flight/rudder",
+                                  "/controls/engines/engine[0]/throttle" };
+
+void yasim_linearize(FGFDM* fdm, const char* file, int nthreads)
+{
+    Airplane* a = fdm->getAirplane();
+    Linearizer lin(a);
+
+    FGFDM** clones = new FGFDM*[nthreads];
+    int i;
+    for(i=1; i<nthreads; i++) {
+        clones[i] = new FGFDM();
+        readXML(file, *clones[i]);
+        clones[i]->getAirplane()->compile();
+        clones[i]->getAirplane()->setupCruise();
+        lin.addClone(clones[i]->getAirplane());
+    }
+
+    lin.setTrimState(a->setupCruise());
+    for(i=0; i<a->numCruiseControls(); i++) {
+        int control; float val;
+        a->getCruiseControl(i, &control, &val);
+        lin.setTrimInput(control, val);
+    }
+    for(i=0; i<(int)(sizeof(LIN_AXES)/sizeof(LIN_AXES[0])); i++) {
+        int handle = fdm->getAxisHandle(LIN_AXES[i]);
+        if(handle >= 0)
+            lin.addInput(handle, LIN_AXES[i]);
+    }
+
+    lin.linearize();
+    lin.write(stdout);
+
+    for(i=1; i<nthreads; i++)
+        delete clones[i];
+    delete[] clones;
+}
+
+// Build a whole-aircraft aerodynamic database, write it to a file,
+// read it back and compare it against the surfaces at random
+// (off-grid) conditions, with all controls moved at once.  Extra
+// copies of the airplane are loaded to spread the evaluations over
+// several threads, as for yasim_linearize().
+struct DbAxis { const char* name; float min, max; int n; };
+static const DbAxis DB_AXES[] = {
+    { "/controls/flight/aileron",  -1, 1, 9 },
+    { "/controls/flight/elevator", -1, 1, 9 },
+    { "/controls/flight/rudder",   -1, 1, 9 },
+    { "/controls/flight/flaps",     0, 1, 5 } };
+
+static float frand(float min, float max)
+{
+    return min + (max - min) * (std::rand() / (float)RAND_MAX);
+}
+
+int yasim_database(FGFDM* fdm, const char* file, const char* out, int nthreads)
+{
+    static const int NCHECK = 2000;
+    Airplane* a = fdm->getAirplane();
+    AeroDatabase gen;
+    int i, j;
+
+    FGFDM** clones = new FGFDM*[nthreads];
+    for(i=1; i<nthreads; i++) {
+        clones[i] = new FGFDM();
+        readXML(file, *clones[i]);
+        clones[i]->getAirplane()->compile();
+        gen.addClone(clones[i]->getAirplane());
+    }
+    for(i=0; i<(int)(sizeof(DB_AXES)/sizeof(DB_AXES[0])); i++) {
+        int handle = fdm->getAxisHandle(DB_AXES[i].name);
+        if(handle >= 0)
+            gen.addControl(handle, DB_AXES[i].name, DB_AXES[i].min,
+                           DB_AXES[i].max, DB_AXES[i].n);
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    gen.generate(a);
+    auto t1 = std::chrono::steady_clock::now();
+    for(i=1; i<nthreads; i++)
+        delete clones[i];
+    delete[] clones;
+
+    FILE* f = fopen(out, "wb");
+    bool ok = f && gen.write(f);
+    if(f) ok = (fclose(f) == 0) && ok;
+    if(!ok) {
+        fprintf(stderr, "Can't write %s\n", out);
+        return 1;
+    }
+
+    // Read it back, as the runtime would.
+    AeroDatabase db;
+    f = fopen(out, "rb");
+    ok = f && db.read(f);
+    if(f) fclose(f);
+    if(!ok) {
+        fprintf(stderr, "Can't read back %s\n", out);
+        return 1;
+    }
+    for(i=0; i<db.numControls(); i++)
+        db.setControlInput(i, fdm->getAxisHandle(db.getControlName(i)));
+
+    // Random conditions inside the grid, but not on it.
+    Model* m = a->getModel();
+    ControlMap* cm = a->getControlMap();
+    Turbulence* turb = m->getTurbulence();
+    m->setTurbulence(0);
+    m->getBody()->recalc();
+    float cg[3];
+    m->getBody()->getCG(cg);
+
+    float err[AeroDatabase::NCOEFS], rms[AeroDatabase::NCOEFS];
+    float range[AeroDatabase::NCOEFS];
+    for(j=0; j<AeroDatabase::NCOEFS; j++)
+        err[j] = rms[j] = range[j] = 0;
+    double nsFull = 0, nsTable = 0;
+    std::srand(1);
+    for(i=0; i<NCHECK; i++) {
+        // Half the points in normal flight, half anywhere
+        float aoa = i & 1 ? frand(-180, 180) : frand(-10, 20);
+        float beta = frand(-15, 15);
+        float spd = frand(20, 100);
+        float rho = Atmosphere::getStdDensity(0);
+
+        cm->reset();
+        for(j=0; j<db.numControls(); j++) {
+            float val = frand(db.getControlMin(j), db.getControlMax(j));
+            int handle = fdm->getAxisHandle(db.getControlName(j));
+            cm->setInput(handle, val);
+            db.setInput(handle, val);
+        }
+        cm->applyControls(1000000);
+        m->setAir(Atmosphere::getStdPressure(0),
+                  Atmosphere::getStdTemperature(0), rho);
+
+        float va[3], rot[3], tmp[3];
+        float ca = Math::cos(aoa*DEG2RAD), sa = Math::sin(aoa*DEG2RAD);
+        float cb = Math::cos(beta*DEG2RAD), sb = Math::sin(beta*DEG2RAD);
+        va[0] = -spd*ca*cb; va[1] = spd*sb; va[2] = spd*sa*cb;
+        for(j=0; j<3; j++) rot[j] = frand(-0.2f, 0.2f);
+
+        State s;
+        for(j=0; j<9; j++) s.orient[j] = (j%4 == 0) ? 1 : 0;
+        for(j=0; j<3; j++) {
+            s.pos[j] = s.acc[j] = s.racc[j] = 0;
+            s.rot[j] = rot[j];
+        }
+        s.pos[2] = 1;
+        Math::cross3(s.rot, cg, tmp);
+        Math::sub3(tmp, va, s.v);
+        m->setState(&s);
+        m->initIteration(1.0/30);
+
+        // The surfaces, moment moved to the origin
+        float force[3], torque[3], faero[3];
+        auto c0 = std::chrono::steady_clock::now();
+        m->getBody()->reset();
+        m->calcAeroForces(m->getState(), 0, faero);
+        auto c1 = std::chrono::steady_clock::now();
+        m->getBody()->getForce(force);
+        m->getBody()->getTorque(torque);
+        Math::cross3(cg, force, tmp);
+        Math::add3(torque, tmp, torque);
+
+        float tforce[3], tmoment[3];
+        auto c2 = std::chrono::steady_clock::now();
+        db.calcForces(va, rot, rho, tforce, tmoment);
+        auto c3 = std::chrono::steady_clock::now();
+        nsFull += std::chrono::duration<double, std::nano>(c1 - c0).count();
+        nsTable += std::chrono::duration<double, std::nano>(c3 - c2).count();
+
+        float q = 0.5f * rho * spd * spd;
+        for(j=0; j<3; j++) {
+            float e[2] = { (tforce[j] - force[j]) / q, (tmoment[j] - torque[j]) / q };
+            float c[2] = { force[j] / q, torque[j] / q };
+            for(int k=0; k<2; k++) {
+                int idx = j + 3*k;
+                if(Math::abs(e[k]) > err[idx]) err[idx] = Math::abs(e[k]);
+                if(Math::abs(c[k]) > range[idx]) range[idx] = Math::abs(c[k]);
+                rms[idx] += e[k]*e[k];
+            }
+        }
+    }
+    m->setTurbulence(turb);
+
+    static const char* NAMES[] = { "Fx", "Fy", "Fz", "Mx", "My", "Mz" };
+    printf("Aerodynamic database: %s\n", out);
+    printf("  Generated in %.2f s with %d thread(s)\n",
+           std::chrono::duration<double>(t1 - t0).count(), nthreads);
+    printf("  Error against the surfaces at %d random points,\n", NCHECK);
+    printf("  as coefficients (force/q in m^2, moment/q in m^3):\n");
+    printf("         max |C|   max error   rms error\n");
+    for(j=0; j<AeroDatabase::NCOEFS; j++)
+        printf("    %s %10.4f %11.5f %11.5f\n", NAMES[j], range[j], err[j],
+               Math::sqrt(rms[j] / NCHECK));
+    printf("  Surfaces: %.1f ns per evaluation\n", nsFull / NCHECK);
+    printf("     Table: %.1f ns per evaluation\n", nsTable / NCHECK);
+    return 0;
+}
+
+// Check the FastMath tiers against the C library (in double): the
+// largest relative error over random arguments in a typical range for
+// each function, and the time per call.
+struct MathCheck {
+    const char* name;
+    float min0, max0, min1, max1; // argument ranges
+    double (*exact)(double, double);
+    float (*tier[3])(float, float);
+};
+
+static MathCheck MATH_CHECKS[] = {
+    { "sin", -10, 10, 0, 0,
+      [](double x, double) { return ::sin(x); },
+      { [](float x, float) { return (float)::sin(x); },
+        [](float x, float) { return FastMath::sin<Math::PRECISE>(x); },
+        [](float x, float) { return FastMath::sin<Math::FAST>(x); } } },
+    { "cos", -10, 10, 0, 0,
+      [](double x, double) { return ::cos(x); },
+      { [](float x, float) { return (float)::cos(x); },
+        [](float x, float) { return FastMath::cos<Math::PRECISE>(x); },
+        [](float x, float) { return FastMath::cos<Math::FAST>(x); } } },
+    { "atan", -100, 100, 0, 0,
+      [](double x, double) { return ::atan(x); },
+      { [](float x, float) { return (float)::atan(x); },
+        [](float x, float) { return FastMath::atan<Math::PRECISE>(x); },
+        [](float x, float) { return FastMath::atan<Math::FAST>(x); } } },
+    { "atan2", -10, 10, -10, 10,
+      [](double y, double x) { return ::atan2(y, x); },
+      { [](float y, float x) { return (float)::atan2(y, x); },
+        [](float y, float x) { return FastMath::atan2<Math::PRECISE>(y, x); },
+        [](float y, float x) { return FastMath::atan2<Math::FAST>(y, x); } } },
+    { "pow", 0.001, 10, -4, 4,
+      [](double b, double e) { return ::pow(b, e); },
+      { [](float b, float e) { return (float)::pow((double)b, (double)e); },
+        [](float b, float e) { return FastMath::pow<Math::PRECISE>(b, e); },
+        [](float b, float e) { return FastMath::pow<Math::FAST>(b, e); } } },
+    { "asin", -1, 1, 0, 0,
+      [](double x, double) { return ::asin(x); },
+      { [](float x, float) { return (float)::asin(x); },
+        [](float x, float) { return FastMath::asin<Math::PRECISE>(x); },
+        [](float x, float) { return FastMath::asin<Math::FAST>(x); } } },
+    { "acos", -1, 1, 0, 0,
+      [](double x, double) { return ::acos(x); },
+      { [](float x, float) { return (float)::acos(x); },
+        [](float x, float) { return FastMath::acos<Math::PRECISE>(x); },
+        [](float x, float) { return FastMath::acos<Math::FAST>(x); } } },
+    { "exp", -20, 20, 0, 0,
+      [](double x, double) { return ::exp(x); },
+      { [](float x, float) { return (float)::exp(x); },
+        [](float x, float) { return FastMath::exp<Math::PRECISE>(x); },
+        [](float x, float) { return FastMath::exp<Math::FAST>(x); } } },
+};
+
+int yasim_mathcheck()
+{
+    static const int N = 1000000;
+    static const float LIMIT[3] = { 1e-6, 2e-6, 2e-4 };
+    float* a = new float[N];
+    float* b = new float[N];
+    int fail = 0;
+
+    printf("Tiered math against libm, %d random arguments each\n", N);
+    printf("  %-6s %12s %12s %12s %9s %9s %9s\n", "", "libm err",
+           "precise err", "fast err", "libm ns", "prec. ns", "fast ns");
+    for(unsigned int f=0; f<sizeof(MATH_CHECKS)/sizeof(MathCheck); f++) {
+        MathCheck* c = &MATH_CHECKS[f];
+        for(int i=0; i<N; i++) {
+            a[i] = frand(c->min0, c->max0);
+            b[i] = frand(c->min1, c->max1);
+        }
+        double err[3], ns[3];
+        for(int t=0; t<3; t++) {
+            err[t] = 0;
+            for(int i=0; i<N; i++) {
+                double e = c->exact(a[i], b[i]);
+                if(e == 0) continue;
+                double r = Math::abs((c->tier[t](a[i], b[i]) - e) / e);
+                if(r > err[t]) err[t] = r;
+            }
+            float sum = 0;
+            auto t0 = std::chrono::steady_clock::now();
+            for(int i=0; i<N; i++)
+                sum += c->tier[t](a[i], b[i]);
+            auto t1 = std::chrono::steady_clock::now();
+            ns[t] = std::chrono::duration<double, std::nano>(t1 - t0).count()
+                / N + 0*sum;
+            if(err[t] > LIMIT[t]) fail = 1;
+        }
+        printf("  %-6s %12.3g %12.3g %12.3g %9.1f %9.1f %9.1f\n", c->name,
+               err[0], err[1], err[2], ns[0], ns[1], ns[2]);
+    }
+    printf("%s\n", fail ? "FAILED: error above the tier's limit" : "OK");
+
+    delete[] a;
+    delete[] b;
+    return fail;
+}
+
+// Loads one of the aircraft's <weight> points with up to max pounds,
+// in both the cruise and approach, and re-solves at each step starting
+// from the last solution.  Each step is also solved from scratch, for
+// comparison (not counting the time to read it).  Prints "lb
+// iterations ms drag lift aoa tail elevator", warm then cold, with
+// the angles in degrees.
+int yasim_loadsweep(FGFDM* fdm, const char* file, int idx, float max,
+                    int steps)
+{
+    Airplane* a = fdm->getAirplane();
+    int fail = 0;
+    printf("#   lb  iter      ms      drag      lift     aoa    tail"
+           "    elev\n");
+    for(int i=0; i<=steps; i++) {
+        float lb = max * i / steps;
+        a->setSolutionWeight(false, idx, lb * LBS2KG);
+        a->setSolutionWeight(true, idx, lb * LBS2KG);
+        auto t0 = std::chrono::steady_clock::now();
+        a->resolve();
+        auto t1 = std::chrono::steady_clock::now();
+
+        FGFDM* cold = new FGFDM();
+        readXML(file, *cold);
+        Airplane* c = cold->getAirplane();
+        c->setSolutionWeight(false, idx, lb * LBS2KG);
+        c->setSolutionWeight(true, idx, lb * LBS2KG);
+        auto t2 = std::chrono::steady_clock::now();
+        c->compile();
+        auto t3 = std::chrono::steady_clock::now();
+
+        Airplane* ac[2] = { a, c };
+        double ms[2] = {
+            std::chrono::duration<double,std::milli>(t1-t0).count(),
+            std::chrono::duration<double,std::milli>(t3-t2).count() };
+        for(int j=0; j<2; j++) {
+            if(ac[j]->getFailureMsg()) {
+                printf("%6.0f  %s: %s\n", lb, j ? "cold" : "warm",
+                       ac[j]->getFailureMsg());
+                fail = 1;
+                continue;
+            }
+            printf("%6.0f  %4d  %6.2f  %8.5f  %8.4f  %6.3f  %6.3f  %6.3f\n",
+                   lb, ac[j]->getSolutionIterations(), ms[j],
+                   1000 * ac[j]->getDragCoefficient(), ac[j]->getLiftRatio(),
+                   ac[j]->getCruiseAoA() * RAD2DEG,
+                   -ac[j]->getTailIncidence() * RAD2DEG,
+                   ac[j]->getApproachElevator());
+        }
+        delete cold;
+    }
+    return fail;
+}
+
+
 int usage()
 {
-    fprintf(stderr, "Usage: yasim <ac.xml> [-g [-a alt] [-s kts]]\n");
+    fprintf(stderr, "Usage: yasim <ac.xml> [-t threads]\n");
+    fprintf(stderr, "       yasim <ac.xml> -g [-a alt] [-s kts]\n");
+    fprintf(stderr, "       yasim -m\n");
+    fprintf(stderr, "       yasim <ac.xml> -l [-t threads]\n");
+    fprintf(stderr, "       yasim <ac.xml> -T [-r resolution] [-a alt] [-s kts]\n");
+    fprintf(stderr, "       yasim <ac.xml> -d <database> [-t threads]\n");
+    fprintf(stderr, "       yasim <ac.xml> -b [-A aoa] [-a alt] [-s kts]\n");
+    fprintf(stderr, "       yasim <ac.xml> -w <weight> <max lb> [-n steps]\n");
+    fprintf(stderr, "       yasim <ac.xml> -p [-t threads] [-W lb,...] [-X m,...] [-F fuel,...]\n");
+    fprintf(stderr, "                         [-S kts,... -A ft,...]\n");
     return 1;
 }
 
+// Solves the aircraft for every combination of the values given for
+// each of the parameters below, spread over several copies of it, one
+// thread each.  The copies are read and compiled once, and re-solve
+// each of their variants from the last (see Airplane::resolve()),
+// taking every nthreads'th variant in order, so a given number of
+// threads always gives the same table.  A copy whose variant fails
+// is read and compiled again, so the next one doesn't start from a
+// failed solution.  The weight is added as
+// ballast at a station ahead of the empty CG; parameters left out
+// stay as in the XML.  Prints one row per variant, "+lb station fuel
+// kts ft iterations ms drag lift aoa tail elevator", the angles in
+// degrees.
+enum { SWEEP_WEIGHT, SWEEP_STATION, SWEEP_FUEL, SWEEP_SPEED, SWEEP_ALT,
+       NSWEEP };
+static const char SWEEP_FLAGS[NSWEEP] = { 'W', 'X', 'F', 'S', 'A' };
+
+struct SweepAxis { float* vals; int n; };
+
+struct SweepResult {
+    float vals[NSWEEP];
+    int iterations;
+    double ms;
+    float drag, lift, aoa, tail, elev;
+    const char* failure;
+};
+
+struct SweepWorker {
+    FGFDM* fdm;
+    bool owned; // read here, not the caller's
+    const char* file;
+    Airplane* airplane;
+    int ballast;
+    float cg[3];
+    int idx, stride;
+    SweepAxis* axes;
+    SweepResult* results;
+    int nresults;
+};
+
+// Compiles a worker's copy, with a ballast for the weight.  Returns
+// the solver's failure message, if any.
+static const char* compileSweepCopy(SweepWorker* w)
+{
+    float zero[3] = { 0, 0, 0 };
+    w->airplane = w->fdm->getAirplane();
+    w->ballast = w->airplane->addBallast(zero, 0);
+    w->airplane->compile();
+    w->airplane->getModel()->getBody()->recalc();
+    w->airplane->getModel()->getBody()->getCG(w->cg);
+    return w->airplane->getFailureMsg();
+}
+
+static void runSweep(SweepWorker* w)
+{
+    for(int v=w->idx; v<w->nresults; v+=w->stride) {
+        SweepResult* r = &w->results[v];
+        Airplane* a = w->airplane;
+        float weight = r->vals[SWEEP_WEIGHT] * LBS2KG;
+        float pos[3] = { w->cg[0] + r->vals[SWEEP_STATION], w->cg[1], w->cg[2] };
+        a->setBallast(w->ballast, pos, weight);
+        if(w->axes[SWEEP_FUEL].n)
+            a->setSolutionFuel(false, r->vals[SWEEP_FUEL]);
+        if(w->axes[SWEEP_SPEED].n || w->axes[SWEEP_ALT].n)
+            a->setSolutionCruise(r->vals[SWEEP_SPEED] * KTS2MPS,
+                                 r->vals[SWEEP_ALT] * FT2M);
+
+        auto t0 = std::chrono::steady_clock::now();
+        a->resolve();
+        auto t1 = std::chrono::steady_clock::now();
+        r->ms = std::chrono::duration<double,std::milli>(t1-t0).count();
+        r->iterations = a->getSolutionIterations();
+        r->failure = a->getFailureMsg();
+        r->drag = 1000 * a->getDragCoefficient();
+        r->lift = a->getLiftRatio();
+        r->aoa = a->getCruiseAoA() * RAD2DEG;
+        r->tail = -a->getTailIncidence() * RAD2DEG;
+        r->elev = a->getApproachElevator();
+
+        // Start the next variant cold, from a fresh copy.
+        if(r->failure && v + w->stride < w->nresults) {
+            if(w->owned)
+                delete w->fdm;
+            w->fdm = new FGFDM();
+            w->owned = true;
+            readXML(w->file, *w->fdm);
+            compileSweepCopy(w);
+        }
+    }
+}
+
+// A comma-separated list of numbers.  Returns how many there were, or
+// -1 if there's something else in it.
+static int parseList(const char* s, float* out, int max)
+{
+    int n = 0;
+    while(n < max) {
+        char* end;
+        out[n++] = std::strtod(s, &end);
+        if(end == s) return -1;
+        if(*end == 0) return n;
+        if(*end != ',') return -1;
+        s = end + 1;
+    }
+    return -1;
+}
+
+int yasim_variants(FGFDM* fdm, const char* file, int argc, char** argv)
+{
+    static const int MAXVALS = 64;
+    float vals[NSWEEP][MAXVALS];
+    SweepAxis axes[NSWEEP];
+    int threads = 1;
+    int i, j;
+    for(j=0; j<NSWEEP; j++) {
+        axes[j].vals = vals[j];
+        axes[j].n = 0;
+    }
+    for(i=0; i<argc; i++) {
+        if(argv[i][0] != '-' || argv[i][2] != 0 || i+1 == argc)
+            return usage();
+        if(argv[i][1] == 't') {
+            threads = std::atoi(argv[++i]);
+            continue;
+        }
+        for(j=0; j<NSWEEP; j++)
+            if(argv[i][1] == SWEEP_FLAGS[j])
+                break;
+        if(j == NSWEEP) return usage();
+        axes[j].n = parseList(argv[++i], vals[j], MAXVALS);
+        if(axes[j].n < 0) return usage();
+    }
+    if(threads < 1) threads = 1;
+    if((axes[SWEEP_SPEED].n == 0) != (axes[SWEEP_ALT].n == 0)) {
+        fprintf(stderr, "A cruise speed needs an altitude, and the reverse\n");
+        return 1;
+    }
+
+    // Every combination, the first parameter varying slowest
+    int nresults = 1;
+    for(j=0; j<NSWEEP; j++)
+        if(axes[j].n) nresults *= axes[j].n;
+    SweepResult* results = new SweepResult[nresults];
+    for(i=0; i<nresults; i++) {
+        int rest = i;
+        for(j=NSWEEP-1; j>=0; j--) {
+            int n = axes[j].n;
+            results[i].vals[j] = n ? vals[j][rest % n] : 0;
+            if(n) rest /= n;
+        }
+    }
+
+    // The copies, read one at a time
+    SweepWorker* workers = new SweepWorker[threads];
+    for(i=0; i<threads; i++) {
+        SweepWorker* w = &workers[i];
+        w->owned = i > 0;
+        w->fdm = w->owned ? new FGFDM() : fdm;
+        w->file = file;
+        if(w->owned)
+            readXML(file, *w->fdm);
+        const char* failure = compileSweepCopy(w);
+        if(failure) {
+            printf("SOLUTION FAILURE: %s\n", failure);
+            for(j=1; j<=i; j++)
+                delete workers[j].fdm;
+            delete[] workers;
+            delete[] results;
+            return 1;
+        }
+        w->idx = i;
+        w->stride = threads;
+        w->axes = axes;
+        w->results = results;
+        w->nresults = nresults;
+    }
+
+    std::thread* pool = new std::thread[threads];
+    auto t0 = std::chrono::steady_clock::now();
+    for(i=1; i<threads; i++)
+        pool[i] = std::thread(runSweep, &workers[i]);
+    runSweep(&workers[0]);
+    for(i=1; i<threads; i++)
+        pool[i].join();
+    auto t1 = std::chrono::steady_clock::now();
+    delete[] pool;
+
+    int fail = 0;
+    printf("#   +lb   sta  fuel   kts     ft  iter      ms      drag"
+           "      lift     aoa    tail    elev\n");
+    for(i=0; i<nresults; i++) {
+        SweepResult* r = &results[i];
+        for(j=0; j<NSWEEP; j++) {
+            static const int WIDTH[NSWEEP] = { 6, 5, 5, 5, 6 };
+            static const int PREC[NSWEEP] = { 0, 2, 2, 0, 0 };
+            if(j) printf(" ");
+            if(axes[j].n || j < SWEEP_FUEL)
+                printf("%*.*f", WIDTH[j], PREC[j], r->vals[j]);
+            else
+                printf("%*s", WIDTH[j], "-");
+        }
+        if(r->failure) {
+            printf("  %s\n", r->failure);
+            fail = 1;
+            continue;
+        }
+        printf("  %4d  %6.2f  %8.5f  %8.4f  %6.3f  %6.3f  %6.3f\n",
+               r->iterations, r->ms, r->drag, r->lift, r->aoa, r->tail,
+               r->elev);
+    }
+    printf("# %d variants in %.3f s with %d thread(s)\n", nresults,
+           std::chrono::duration<double>(t1 - t0).count(), threads);
+
+    for(i=0; i<threads; i++)
+        if(workers[i].owned)
+            delete workers[i].fdm;
+    delete[] workers;
+    delete[] results;
+    return fail;
+}
+
 int main(int argc, char** argv)
 {
     FGFDM* fdm = new FGFDM();
     Airplane* a = fdm->getAirplane();
 
     if(argc < 2) return usage();
+    if(strcmp(argv[1], "-m") == 0) {
+        delete fdm;
+        return yasim_mathcheck();
+    }
 
     // Read
     try {
@@ -78,8 +787,33 @@ int main(int argc, char** argv)
                e.getFormattedMessage().c_str(), e.getOrigin());
     }
 
+    // The variants compile their own copies
+    if(argc > 2 && strcmp(argv[2], "-p") == 0) {
+        int ret = yasim_variants(fdm, argv[1], argc-3, argv+3);
+        delete fdm;
+        return ret;
+    }
+
+    // Extra copies for the solver to run on in parallel (with the
+    // solution report only)
+    int solveThreads = 1;
+    if(argc > 2 && strcmp(argv[2], "-t") == 0) {
+        if(argc != 4) return usage();
+        solveThreads = std::atoi(argv[3]);
+    }
+    FGFDM** clones = new FGFDM*[solveThreads > 1 ? solveThreads : 1];
+    int i;
+    for(i=1; i<solveThreads; i++) {
+        clones[i] = new FGFDM();
+        readXML(argv[1], *clones[i]);
+        a->addSolveClone(clones[i]->getAirplane());
+    }
+
     // ... and run
     a->compile();
+    for(i=1; i<solveThreads; i++)
+        delete clones[i];
+    delete[] clones;
     if(a->getFailureMsg())
         printf("SOLUTION FAILURE: %s\n", a->getFailureMsg());
 
@@ -91,6 +825,56 @@ int main(int argc, char** argv)
             else return usage();
         }
         yasim_graph(a, alt, kts);
+    } else if(!a->getFailureMsg() && argc > 2 && strcmp(argv[2], "-l") == 0) {
+        int threads = 1;
+        for(int i=3; i<argc; i++) {
+            if(std::strcmp(argv[i], "-t") == 0) threads = std::atoi(argv[++i]);
+            else return usage();
+        }
+        if(threads < 1) threads = 1;
+        yasim_linearize(fdm, argv[1], threads);
+    } else if(!a->getFailureMsg() && argc > 2 && strcmp(argv[2], "-T") == 0) {
+        int res = 4096;
+        float alt = 5000, kts = 100;
+        for(int i=3; i<argc; i++) {
+            if     (std::strcmp(argv[i], "-r") == 0) res = std::atoi(argv[++i]);
+            else if(std::strcmp(argv[i], "-a") == 0) alt = std::atof(argv[++i]);
+            else if(std::strcmp(argv[i], "-s") == 0) kts = std::atof(argv[++i]);
+            else return usage();
+        }
+        yasim_tables(a, res, alt, kts);
+    } else if(!a->getFailureMsg() && argc > 2 && strcmp(argv[2], "-b") == 0) {
+        float aoa = a->getCruiseAoA() * RAD2DEG, alt = 5000, kts = 100;
+        for(int i=3; i<argc; i++) {
+            if     (std::strcmp(argv[i], "-A") == 0) aoa = std::atof(argv[++i]);
+            else if(std::strcmp(argv[i], "-a") == 0) alt = std::atof(argv[++i]);
+            else if(std::strcmp(argv[i], "-s") == 0) kts = std::atof(argv[++i]);
+            else return usage();
+        }
+        int ret = yasim_breakdown(a, aoa, alt, kts);
+        delete fdm;
+        return ret;
+    } else if(!a->getFailureMsg() && argc > 4 && strcmp(argv[2], "-w") == 0) {
+        int steps = 10;
+        for(int i=5; i<argc; i++) {
+            if(std::strcmp(argv[i], "-n") == 0) steps = std::atoi(argv[++i]);
+            else return usage();
+        }
+        if(steps < 1) steps = 1;
+        int ret = yasim_loadsweep(fdm, argv[1], std::atoi(argv[3]),
+                                  std::atof(argv[4]), steps);
+        delete fdm;
+        return ret;
+    } else if(!a->getFailureMsg() && argc > 3 && strcmp(argv[2], "-d") == 0) {
+        int threads = 1;
+        for(int i=4; i<argc; i++) {
+            if(std::strcmp(argv[i], "-t") == 0) threads = std::atoi(argv[++i]);
+            else return usage();
+        }
+        if(threads < 1) threads = 1;
+        int ret = yasim_database(fdm, argv[1], argv[3], threads);
+        delete fdm;
+        return ret;
     } else {
         float aoa = a->getCruiseAoA() * RAD2DEG;
         float tail = -1 * a->getTailIncidence() * RAD2DEG;